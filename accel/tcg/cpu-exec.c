@@ -222,9 +222,9 @@ static bool tb_lookup_cmp(const void *p, const void *d)
     return false;
 }
 
-static TranslationBlock *tb_htable_lookup(CPUState *cpu, vaddr pc,
-                                          uint64_t cs_base, uint32_t flags,
-                                          uint32_t cflags)
+TranslationBlock *tb_htable_lookup(CPUState *cpu, vaddr pc,
+                                   uint64_t cs_base, uint32_t flags,
+                                   uint32_t cflags)
 {
     tb_page_addr_t phys_pc;
     struct tb_desc desc;
@@ -245,6 +245,65 @@ static TranslationBlock *tb_htable_lookup(CPUState *cpu, vaddr pc,
     return qht_lookup_custom(&tb_ctx.htable, &desc, h, tb_lookup_cmp);
 }
 
+static CPUJumpCache *tb_jmp_cache_new(unsigned int bits)
+{
+    CPUJumpCache *jc;
+
+    jc = g_malloc0(sizeof(*jc) + (sizeof(jc->array[0]) << bits));
+    jc->mask = (1u << bits) - 1;
+    return jc;
+}
+
+/*
+ * The jump cache is resized when TB_JMP_CACHE_WINDOW lookups missed
+ * because of a conflict, that is because the entry held another pc,
+ * in fewer than TB_JMP_CACHE_WINDOW * 16 lookups.  Misses on an empty
+ * entry, after a flush or for new code, do not count: a larger cache
+ * would not avoid them.
+ */
+#define TB_JMP_CACHE_WINDOW 1024
+
+static CPUJumpCache *tb_jmp_cache_grow(CPUState *cpu, CPUJumpCache *old)
+{
+    CPUJumpCache *jc = tb_jmp_cache_new(ctz32(old->mask + 1) + 1);
+
+    jc->lookup_ptr_hits = old->lookup_ptr_hits;
+    jc->lookup_ptr_misses = old->lookup_ptr_misses;
+    jc->links = old->links;
+    jc->links_cross_page = old->links_cross_page;
+    jc->hits = old->hits;
+    jc->misses = old->misses;
+    jc->conflicts = old->conflicts;
+    jc->resizes = old->resizes + 1;
+
+    /*
+     * The new cache starts empty.  TBs that are invalidated meanwhile
+     * are already out of the hash table, so they cannot be added to it.
+     */
+    qatomic_rcu_set(&cpu->tb_jmp_cache, jc);
+    g_free_rcu(old, rcu);
+    return jc;
+}
+
+static CPUJumpCache *tb_jmp_cache_conflict(CPUState *cpu, CPUJumpCache *jc)
+{
+    uint64_t lookups;
+
+    qatomic_set(&jc->conflicts, jc->conflicts + 1);
+    if (++jc->window_conflicts < TB_JMP_CACHE_WINDOW) {
+        return jc;
+    }
+
+    lookups = jc->hits + jc->misses - jc->window_lookups;
+    if (lookups < TB_JMP_CACHE_WINDOW * 16 &&
+        jc->mask < (1u << TB_JMP_CACHE_MAX_BITS) - 1) {
+        jc = tb_jmp_cache_grow(cpu, jc);
+    }
+    jc->window_lookups = jc->hits + jc->misses;
+    jc->window_conflicts = 0;
+    return jc;
+}
+
 /* Might cause an exception, so have a longjmp destination ready */
 static inline TranslationBlock *tb_lookup(CPUState *cpu, vaddr pc,
                                           uint64_t cs_base, uint32_t flags,
@@ -253,12 +312,13 @@ static inline TranslationBlock *tb_lookup(CPUState *cpu, vaddr pc,
     TranslationBlock *tb;
     CPUJumpCache *jc;
     uint32_t hash;
+    bool conflict;
 
     /* we should never be trying to look up an INVALID tb */
     tcg_debug_assert(!(cflags & CF_INVALID));
 
-    hash = tb_jmp_cache_hash_func(pc);
     jc = cpu->tb_jmp_cache;
+    hash = tb_jmp_cache_hash_func(jc, pc);
 
     tb = qatomic_read(&jc->array[hash].tb);
     if (likely(tb &&
@@ -266,14 +326,21 @@ static inline TranslationBlock *tb_lookup(CPUState *cpu, vaddr pc,
                tb->cs_base == cs_base &&
                tb->flags == flags &&
                tb_cflags(tb) == cflags)) {
+        qatomic_set(&jc->hits, jc->hits + 1);
         goto hit;
     }
+    conflict = tb && jc->array[hash].pc != pc;
+    qatomic_set(&jc->misses, jc->misses + 1);
 
     tb = tb_htable_lookup(cpu, pc, cs_base, flags, cflags);
     if (tb == NULL) {
         return NULL;
     }
 
+    if (conflict) {
+        jc = tb_jmp_cache_conflict(cpu, jc);
+        hash = tb_jmp_cache_hash_func(jc, pc);
+    }
     jc->array[hash].pc = pc;
     qatomic_set(&jc->array[hash].tb, tb);
 
@@ -423,14 +490,18 @@ const void *HELPER(lookup_tb_ptr)(CPUArchState *env)
 
     tb = tb_lookup(cpu, pc, cs_base, flags, cflags);
     if (tb == NULL) {
+        qatomic_set(&cpu->tb_jmp_cache->lookup_ptr_misses,
+                    cpu->tb_jmp_cache->lookup_ptr_misses + 1);
         return tcg_code_gen_epilogue;
     }
+    qatomic_set(&cpu->tb_jmp_cache->lookup_ptr_hits,
+                cpu->tb_jmp_cache->lookup_ptr_hits + 1);
 
     if (qemu_loglevel_mask(CPU_LOG_TB_CPU | CPU_LOG_EXEC)) {
         log_cpu_exec(pc, cpu, tb);
     }
 
-    return tb->tc.ptr;
+    return tb->tc.ptr + tb->chain_offset;
 }
 
 /* Execute a TB, and fix up the CPU state afterwards if necessary */
@@ -636,9 +707,10 @@ void tb_set_jmp_target(TranslationBlock *tb, int n, uintptr_t addr)
     tb_target_set_jmp_target(c_tb, n, jmp_rx, jmp_rw);
 }
 
-static inline void tb_add_jump(TranslationBlock *tb, int n,
+static inline void tb_add_jump(CPUState *cpu, TranslationBlock *tb, int n,
                                TranslationBlock *tb_next)
 {
+    CPUJumpCache *jc = cpu->tb_jmp_cache;
     uintptr_t old;
 
     qemu_thread_jit_write();
@@ -657,7 +729,8 @@ static inline void tb_add_jump(TranslationBlock *tb, int n,
     }
 
     /* patch the native jump address */
-    tb_set_jmp_target(tb, n, (uintptr_t)tb_next->tc.ptr);
+    tb_set_jmp_target(tb, n,
+                      (uintptr_t)tb_next->tc.ptr + tb_next->chain_offset);
 
     /* add in TB jmp list */
     tb->jmp_list_next[n] = tb_next->jmp_list_head;
@@ -665,6 +738,11 @@ static inline void tb_add_jump(TranslationBlock *tb, int n,
 
     qemu_spin_unlock(&tb_next->jmp_lock);
 
+    qatomic_set(&jc->links, jc->links + 1);
+    if ((tb_page_addr0(tb) ^ tb_page_addr0(tb_next)) & TARGET_PAGE_MASK) {
+        qatomic_set(&jc->links_cross_page, jc->links_cross_page + 1);
+    }
+
     qemu_log_mask(CPU_LOG_EXEC, "Linking TBs %p index %d -> %p\n",
                   tb->tc.ptr, n, tb_next->tc.ptr);
     return;
@@ -923,6 +1001,15 @@ static inline void cpu_loop_exec_tb(CPUState *cpu, TranslationBlock *tb,
         return;
     }
 
+    if (tb->profiled) {
+        /*
+         * The profiling code at the start of the TB found it hot.
+         * Profiled TBs never run with icount, see tb_gen_code().
+         */
+        tb_gen_hot(cpu, tb);
+        return;
+    }
+
     /* Instruction counter expired.  */
     assert(icount_enabled());
 #ifndef CONFIG_USER_ONLY
@@ -997,8 +1084,8 @@ cpu_exec_loop(CPUState *cpu, SyncClocks *sc)
                  * We add the TB in the virtual pc hash table
                  * for the fast lookup
                  */
-                h = tb_jmp_cache_hash_func(pc);
                 jc = cpu->tb_jmp_cache;
+                h = tb_jmp_cache_hash_func(jc, pc);
                 jc->array[h].pc = pc;
                 qatomic_set(&jc->array[h].tb, tb);
             }
@@ -1016,7 +1103,7 @@ cpu_exec_loop(CPUState *cpu, SyncClocks *sc)
 #endif
             /* See if we can patch the calling TB. */
             if (last_tb) {
-                tb_add_jump(last_tb, tb_exit, tb);
+                tb_add_jump(cpu, last_tb, tb_exit, tb);
             }
 
             cpu_loop_exec_tb(cpu, tb, pc, &last_tb, &tb_exit);
@@ -1082,7 +1169,7 @@ bool tcg_exec_realizefn(CPUState *cpu, Error **errp)
         tcg_target_initialized = true;
     }
 
-    cpu->tb_jmp_cache = g_new0(CPUJumpCache, 1);
+    cpu->tb_jmp_cache = tb_jmp_cache_new(TB_JMP_CACHE_BITS);
     tlb_init(cpu);
 #ifndef CONFIG_USER_ONLY
     tcg_iommu_init_notifier_list(cpu);
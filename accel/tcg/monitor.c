@@ -19,6 +19,7 @@
 #include "tcg/tcg.h"
 #include "internal-common.h"
 #include "tb-context.h"
+#include "tb-jmp-cache.h"
 
 
 static void dump_drift_info(GString *buf)
@@ -141,6 +142,57 @@ static void tlb_flush_counts(size_t *pfull, size_t *ppart, size_t *pelide)
     *pelide = elide;
 }
 
+static void tb_exit_counts(uint64_t *phits, uint64_t *pmisses,
+                           uint64_t *plinks, uint64_t *pcross)
+{
+    CPUState *cpu;
+    uint64_t hits = 0, misses = 0, links = 0, cross = 0;
+
+    RCU_READ_LOCK_GUARD();
+    CPU_FOREACH(cpu) {
+        CPUJumpCache *jc = qatomic_rcu_read(&cpu->tb_jmp_cache);
+
+        if (jc) {
+            hits += qatomic_read(&jc->lookup_ptr_hits);
+            misses += qatomic_read(&jc->lookup_ptr_misses);
+            links += qatomic_read(&jc->links);
+            cross += qatomic_read(&jc->links_cross_page);
+        }
+    }
+    *phits = hits;
+    *pmisses = misses;
+    *plinks = links;
+    *pcross = cross;
+}
+
+struct jmp_cache_stats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t conflicts;
+    size_t entries;
+    size_t max_entries;
+    unsigned resizes;
+};
+
+static void jmp_cache_stats(struct jmp_cache_stats *st)
+{
+    CPUState *cpu;
+
+    RCU_READ_LOCK_GUARD();
+    CPU_FOREACH(cpu) {
+        CPUJumpCache *jc = qatomic_rcu_read(&cpu->tb_jmp_cache);
+
+        if (jc) {
+            st->hits += qatomic_read(&jc->hits);
+            st->misses += qatomic_read(&jc->misses);
+            st->conflicts += qatomic_read(&jc->conflicts);
+            st->entries += jc->mask + 1;
+            st->max_entries = MAX(st->max_entries, jc->mask + 1);
+            st->resizes += qatomic_read(&jc->resizes);
+        }
+    }
+}
+
 static void tcg_dump_info(GString *buf)
 {
     g_string_append_printf(buf, "[TCG profiler not compiled]\n");
@@ -151,6 +203,8 @@ static void dump_exec_info(GString *buf)
     struct tb_tree_stats tst = {};
     struct qht_stats hst;
     size_t nb_tbs, flush_full, flush_part, flush_elide;
+    uint64_t lookup_hits, lookup_misses, links, links_cross;
+    struct jmp_cache_stats jst = {};
 
     tcg_tb_foreach(tb_tree_stats_iter, &tst);
     nb_tbs = tst.nb_tbs;
@@ -189,6 +243,9 @@ static void dump_exec_info(GString *buf)
     g_string_append_printf(buf, "\nStatistics:\n");
     g_string_append_printf(buf, "TB flush count      %u\n",
                            qatomic_read(&tb_ctx.tb_flush_count));
+    g_string_append_printf(buf, "TB evict count      %u (%zu TBs)\n",
+                           qatomic_read(&tb_ctx.tb_evict_count),
+                           qatomic_read(&tb_ctx.tb_evicted));
     g_string_append_printf(buf, "TB invalidate count %u\n",
                            qatomic_read(&tb_ctx.tb_phys_invalidate_count));
 
@@ -196,6 +253,22 @@ static void dump_exec_info(GString *buf)
     g_string_append_printf(buf, "TLB full flushes    %zu\n", flush_full);
     g_string_append_printf(buf, "TLB partial flushes %zu\n", flush_part);
     g_string_append_printf(buf, "TLB elided flushes  %zu\n", flush_elide);
+
+    tb_exit_counts(&lookup_hits, &lookup_misses, &links, &links_cross);
+    g_string_append_printf(buf, "lookup_tb_ptr hits  %" PRIu64
+                           " (misses %" PRIu64 ")\n",
+                           lookup_hits, lookup_misses);
+    g_string_append_printf(buf, "TB links            %" PRIu64
+                           " (cross page %" PRIu64 ")\n",
+                           links, links_cross);
+
+    jmp_cache_stats(&jst);
+    g_string_append_printf(buf, "jump cache hits     %" PRIu64
+                           " (misses %" PRIu64 ", conflicts %" PRIu64 ")\n",
+                           jst.hits, jst.misses, jst.conflicts);
+    g_string_append_printf(buf, "jump cache entries  %zu max=%zu "
+                           "(resizes %u)\n",
+                           jst.entries, jst.max_entries, jst.resizes);
     tcg_dump_info(buf);
 }
 
@@ -12,8 +12,13 @@
 #include "qemu/rcu.h"
 #include "exec/cpu-common.h"
 
+/*
+ * The cache starts with 1 << TB_JMP_CACHE_BITS entries, and is doubled
+ * up to 1 << TB_JMP_CACHE_MAX_BITS entries by its CPU when too many
+ * lookups miss because another TB took the entry (see tb_lookup()).
+ */
 #define TB_JMP_CACHE_BITS 12
-#define TB_JMP_CACHE_SIZE (1 << TB_JMP_CACHE_BITS)
+#define TB_JMP_CACHE_MAX_BITS 16
 
 /*
  * Invalidated in parallel; all accesses to 'tb' must be atomic.
@@ -21,13 +26,39 @@
  * no need for qatomic_rcu_read() and pc is always consistent with a
  * non-NULL value of 'tb'.  Strictly speaking pc is only needed for
  * CF_PCREL, but it's used always for simplicity.
+ *
+ * When the cache is resized, its CPU publishes the new one with
+ * qatomic_rcu_set() and frees the old one after a grace period, so
+ * other threads must use qatomic_rcu_read() to get cpu->tb_jmp_cache.
  */
 typedef struct CPUJumpCache {
     struct rcu_head rcu;
+
+    /*
+     * Statistics for "info jit".  Only written by the owning CPU,
+     * read with qatomic_read() by the monitor.  They are carried over
+     * when the cache is resized.
+     */
+    uint64_t lookup_ptr_hits;
+    uint64_t lookup_ptr_misses;
+    uint64_t links;
+    uint64_t links_cross_page;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t conflicts;
+    uint32_t resizes;
+
+    /* Number of entries - 1 */
+    uint32_t mask;
+
+    /* Resize heuristic, private to the owning CPU */
+    uint64_t window_lookups;
+    uint32_t window_conflicts;
+
     struct {
         TranslationBlock *tb;
         vaddr pc;
-    } array[TB_JMP_CACHE_SIZE];
+    } array[];
 } CPUJumpCache;
 
 #endif /* ACCEL_TCG_TB_JMP_CACHE_H */
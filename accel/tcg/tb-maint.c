@@ -20,6 +20,7 @@
 #include "qemu/osdep.h"
 #include "qemu/interval-tree.h"
 #include "qemu/qtree.h"
+#include "qemu/rcu.h"
 #include "exec/cputlb.h"
 #include "exec/log.h"
 #include "exec/exec-all.h"
@@ -799,6 +800,59 @@ void tb_flush(CPUState *cpu)
     }
 }
 
+static gboolean tb_evict_one(gpointer key, gpointer value, gpointer data)
+{
+    TranslationBlock *tb = value;
+    size_t *n = data;
+
+    if (!(tb_cflags(tb) & CF_INVALID)) {
+        tb_phys_invalidate(tb, -1);
+        (*n)++;
+    }
+    return false;
+}
+
+/* free the oldest part of the code buffer, or all of it */
+static void do_tb_evict(CPUState *cpu, run_on_cpu_data tb_reclaim_count)
+{
+    size_t n = 0;
+    bool evicted;
+
+    mmap_lock();
+    /* If space was reclaimed meanwhile, just retry. */
+    if (tb_ctx.tb_flush_count + tb_ctx.tb_evict_count !=
+        tb_reclaim_count.host_int) {
+        mmap_unlock();
+        return;
+    }
+
+    qemu_thread_jit_write();
+    evicted = tcg_region_evict(tb_evict_one, &n);
+    qemu_thread_jit_execute();
+    if (evicted) {
+        qatomic_inc(&tb_ctx.tb_evict_count);
+        qatomic_set(&tb_ctx.tb_evicted, tb_ctx.tb_evicted + n);
+    }
+    mmap_unlock();
+
+    if (!evicted) {
+        do_tb_flush(cpu, RUN_ON_CPU_HOST_INT(tb_ctx.tb_flush_count));
+    }
+}
+
+void tb_evict(CPUState *cpu)
+{
+    unsigned tb_reclaim_count = qatomic_read(&tb_ctx.tb_flush_count) +
+                                qatomic_read(&tb_ctx.tb_evict_count);
+
+    if (cpu_in_serial_context(cpu)) {
+        do_tb_evict(cpu, RUN_ON_CPU_HOST_INT(tb_reclaim_count));
+    } else {
+        async_safe_run_on_cpu(cpu, do_tb_evict,
+                              RUN_ON_CPU_HOST_INT(tb_reclaim_count));
+    }
+}
+
 /* remove @orig from its @n_orig-th jump list */
 static inline void tb_remove_from_jmp_list(TranslationBlock *orig, int n_orig)
 {
@@ -879,16 +933,17 @@ static void tb_jmp_cache_inval_tb(TranslationBlock *tb)
 {
     CPUState *cpu;
 
+    /* Other vCPUs may replace their cache meanwhile, see tb_lookup() */
+    RCU_READ_LOCK_GUARD();
     if (tb_cflags(tb) & CF_PCREL) {
         /* A TB may be at any virtual address */
         CPU_FOREACH(cpu) {
             tcg_flush_jmp_cache(cpu);
         }
     } else {
-        uint32_t h = tb_jmp_cache_hash_func(tb->pc);
-
         CPU_FOREACH(cpu) {
-            CPUJumpCache *jc = cpu->tb_jmp_cache;
+            CPUJumpCache *jc = qatomic_rcu_read(&cpu->tb_jmp_cache);
+            uint32_t h = tb_jmp_cache_hash_func(jc, tb->pc);
 
             if (qatomic_read(&jc->array[h].tb) == tb) {
                 qatomic_set(&jc->array[h].tb, NULL);
@@ -47,6 +47,13 @@ struct TCGState {
     bool one_insn_per_tb;
     int splitwx_enabled;
     unsigned long tb_size;
+    bool tb_evict;
+    char *tb_cache;
+    uint32_t trace_threshold;
+    uint32_t tier_threshold;
+    uint32_t pin_regs;
+    bool hot_regs;
+    bool cse;
 };
 typedef struct TCGState TCGState;
 
@@ -99,6 +106,8 @@ static void tcg_accel_instance_init(Object *obj)
 
 bool mttcg_enabled;
 bool one_insn_per_tb;
+uint32_t tcg_trace_threshold;
+uint32_t tcg_tier_threshold;
 
 static int tcg_init_machine(MachineState *ms)
 {
@@ -114,6 +123,15 @@ static int tcg_init_machine(MachineState *ms)
 
     page_init();
     tb_htable_init();
+#if !defined(CONFIG_USER_ONLY)
+    if (s->tb_cache) {
+        tb_cache_open(s->tb_cache);
+    }
+#endif
+    tcg_set_pinned_limit(s->pin_regs);
+    tcg_set_hot_pinning(s->hot_regs);
+    tcg_set_optimize_cse(s->cse);
+    tcg_region_set_evict(s->tb_evict);
     tcg_init(s->tb_size * MiB, s->splitwx_enabled, max_cpus);
 
 #if defined(CONFIG_SOFTMMU)
@@ -181,6 +199,130 @@ static void tcg_set_tb_size(Object *obj, Visitor *v,
     s->tb_size = value;
 }
 
+static void tcg_get_trace_threshold(Object *obj, Visitor *v,
+                                    const char *name, void *opaque,
+                                    Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    uint32_t value = s->trace_threshold;
+
+    visit_type_uint32(v, name, &value, errp);
+}
+
+static void tcg_set_trace_threshold(Object *obj, Visitor *v,
+                                    const char *name, void *opaque,
+                                    Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    uint32_t value;
+
+    if (!visit_type_uint32(v, name, &value, errp)) {
+        return;
+    }
+    if (value > INT32_MAX) {
+        error_setg(errp, "trace-threshold must be at most %d", INT32_MAX);
+        return;
+    }
+
+    s->trace_threshold = value;
+    qatomic_set(&tcg_trace_threshold, value);
+}
+
+static void tcg_get_tier_threshold(Object *obj, Visitor *v,
+                                   const char *name, void *opaque,
+                                   Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    uint32_t value = s->tier_threshold;
+
+    visit_type_uint32(v, name, &value, errp);
+}
+
+static void tcg_set_tier_threshold(Object *obj, Visitor *v,
+                                   const char *name, void *opaque,
+                                   Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    uint32_t value;
+
+    if (!visit_type_uint32(v, name, &value, errp)) {
+        return;
+    }
+    if (value > INT32_MAX) {
+        error_setg(errp, "tier-threshold must be at most %d", INT32_MAX);
+        return;
+    }
+
+    s->tier_threshold = value;
+    qatomic_set(&tcg_tier_threshold, value);
+}
+
+static void tcg_get_pin_regs(Object *obj, Visitor *v,
+                             const char *name, void *opaque,
+                             Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    uint32_t value = s->pin_regs;
+
+    visit_type_uint32(v, name, &value, errp);
+}
+
+static void tcg_set_pin_regs(Object *obj, Visitor *v,
+                             const char *name, void *opaque,
+                             Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    uint32_t value;
+
+    if (!visit_type_uint32(v, name, &value, errp)) {
+        return;
+    }
+
+    s->pin_regs = value;
+}
+
+static bool tcg_get_hot_regs(Object *obj, Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+
+    return s->hot_regs;
+}
+
+static void tcg_set_hot_regs(Object *obj, bool value, Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+
+    s->hot_regs = value;
+}
+
+static bool tcg_get_cse(Object *obj, Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+
+    return s->cse;
+}
+
+static void tcg_set_cse(Object *obj, bool value, Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+
+    s->cse = value;
+}
+
+static bool tcg_get_tb_evict(Object *obj, Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+
+    return s->tb_evict;
+}
+
+static void tcg_set_tb_evict(Object *obj, bool value, Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+
+    s->tb_evict = value;
+}
+
 static bool tcg_get_splitwx(Object *obj, Error **errp)
 {
     TCGState *s = TCG_STATE(obj);
@@ -207,6 +349,23 @@ static void tcg_set_one_insn_per_tb(Object *obj, bool value, Error **errp)
     qatomic_set(&one_insn_per_tb, value);
 }
 
+#if !defined(CONFIG_USER_ONLY)
+static char *tcg_get_tb_cache(Object *obj, Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+
+    return g_strdup(s->tb_cache);
+}
+
+static void tcg_set_tb_cache(Object *obj, const char *value, Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+
+    g_free(s->tb_cache);
+    s->tb_cache = g_strdup(value);
+}
+#endif
+
 static int tcg_gdbstub_supported_sstep_flags(void)
 {
     /*
@@ -242,6 +401,45 @@ static void tcg_accel_class_init(ObjectClass *oc, void *data)
     object_class_property_set_description(oc, "tb-size",
         "TCG translation block cache size");
 
+    object_class_property_add_bool(oc, "tb-evict",
+        tcg_get_tb_evict, tcg_set_tb_evict);
+    object_class_property_set_description(oc, "tb-evict",
+        "Evict the oldest translations when the TCG translation block "
+        "cache is full, instead of flushing it");
+
+    object_class_property_add(oc, "trace-threshold", "uint32",
+        tcg_get_trace_threshold, tcg_set_trace_threshold,
+        NULL, NULL);
+    object_class_property_set_description(oc, "trace-threshold",
+        "Executions after which a TB is retranslated as a trace "
+        "(0 disables tracing)");
+
+    object_class_property_add(oc, "tier-threshold", "uint32",
+        tcg_get_tier_threshold, tcg_set_tier_threshold,
+        NULL, NULL);
+    object_class_property_set_description(oc, "tier-threshold",
+        "Executions after which an unoptimized TB is retranslated "
+        "with the optimizer (0 disables tiering)");
+
+    object_class_property_add(oc, "pin-regs", "uint32",
+        tcg_get_pin_regs, tcg_set_pin_regs,
+        NULL, NULL);
+    object_class_property_set_description(oc, "pin-regs",
+        "Number of guest registers kept in host registers across "
+        "TBs (0 disables pinning)");
+
+    object_class_property_add_bool(oc, "hot-regs",
+        tcg_get_hot_regs, tcg_set_hot_regs);
+    object_class_property_set_description(oc, "hot-regs",
+        "Keep the guest registers used throughout hot TBs in host "
+        "registers within those TBs");
+
+    object_class_property_add_bool(oc, "cse",
+        tcg_get_cse, tcg_set_cse);
+    object_class_property_set_description(oc, "cse",
+        "Eliminate common subexpressions and overwritten env stores "
+        "in the TCG optimizer");
+
     object_class_property_add_bool(oc, "split-wx",
         tcg_get_splitwx, tcg_set_splitwx);
     object_class_property_set_description(oc, "split-wx",
@@ -252,6 +450,15 @@ static void tcg_accel_class_init(ObjectClass *oc, void *data)
                                    tcg_set_one_insn_per_tb);
     object_class_property_set_description(oc, "one-insn-per-tb",
         "Only put one guest insn in each translation block");
+
+#if !defined(CONFIG_USER_ONLY)
+    object_class_property_add_str(oc, "tb-cache",
+                                  tcg_get_tb_cache,
+                                  tcg_set_tb_cache);
+    object_class_property_set_description(oc, "tb-cache",
+        "File listing the ROM code to translate at startup, "
+        "updated at exit");
+#endif
 }
 
 static const TypeInfo tcg_accel_type = {
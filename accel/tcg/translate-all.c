@@ -65,6 +65,16 @@
 #include "internal-target.h"
 #include "tcg/perf.h"
 #include "tcg/insn-start-words.h"
+#ifndef CONFIG_USER_ONLY
+#include "exec/address-spaces.h"
+#include "qemu/crc32c.h"
+#include "qemu/cutils.h"
+#include "qemu/error-report.h"
+#include "qemu/plugin.h"
+#include "qemu/rcu.h"
+#include "sysemu/runstate.h"
+#include "sysemu/sysemu.h"
+#endif
 
 TBContext tb_ctx;
 
@@ -259,6 +269,116 @@ void page_init(void)
     page_table_config_init();
 }
 
+/*
+ * The hot TB being retranslated by this thread, see tb_gen_hot().
+ * @request is consumed by the next tb_gen_code(), which sets @active
+ * for the duration of the translation.  @tier_up is consumed likewise,
+ * and asks for a tier 0 TB to be translated again with the optimizer.
+ */
+static __thread struct {
+    bool request;
+    bool active;
+    bool tier_up;
+    CPUState *cpu;
+    TranslationBlock *head;
+    vaddr pc;
+    uint32_t cflags;
+} trace_state;
+
+/* A goto_tb exit must be sampled this often and be taken this much ... */
+#define TRACE_MIN_SAMPLES   64
+/* ... out of every 8 times to be followed by a trace. */
+#define TRACE_BIAS          7
+
+/*
+ * Retranslate @head, which the CPU is about to execute again and whose
+ * profiling code found it hot.  A tier 0 TB is translated again with the
+ * full optimizer, any other TB as a trace.  The new TB replaces @head
+ * under the same lookup key.
+ */
+void tb_gen_hot(CPUState *cpu, TranslationBlock *head)
+{
+    vaddr pc;
+    uint64_t cs_base;
+    uint32_t flags, cflags = tb_cflags(head);
+
+    /* Another vCPU may have retranslated it already. */
+    if (cflags & CF_INVALID) {
+        return;
+    }
+
+    cpu_get_tb_cpu_state(cpu_env(cpu), &pc, &cs_base, &flags);
+    if (head->cs_base != cs_base || head->flags != flags ||
+        cflags != curr_cflags(cpu)) {
+        /*
+         * The CPU state changed under the TB, e.g. because of an
+         * interrupt.  Count down again instead of leaving @head on
+         * every execution.
+         */
+        uint32_t threshold = qatomic_read(head->tier0 ? &tcg_tier_threshold
+                                                      : &tcg_trace_threshold);
+        qatomic_set(&head->trace_count, threshold ?: INT32_MAX);
+        return;
+    }
+
+    mmap_lock();
+    if (tb_cflags(head) & CF_INVALID) {
+        mmap_unlock();
+        return;
+    }
+    tb_phys_invalidate(head, -1);
+
+    trace_state.request = !head->tier0;
+    trace_state.tier_up = head->tier0;
+    trace_state.cpu = cpu;
+    trace_state.head = head;
+    trace_state.pc = pc;
+    trace_state.cflags = cflags;
+    tb_gen_code(cpu, pc, cs_base, flags, cflags);
+    trace_state.active = false;
+    mmap_unlock();
+}
+
+/*
+ * While translating a trace, return the goto_tb exit that the profiled TB
+ * [@pc, @end) takes most of the time, or -1 if there is none.
+ */
+int tb_trace_hot_exit(vaddr pc, vaddr end)
+{
+    TranslationBlock *tb;
+    uint64_t n0, n1;
+
+    if (!trace_state.active) {
+        return -1;
+    }
+    if (pc == trace_state.pc) {
+        tb = trace_state.head;
+    } else {
+        tb = tb_htable_lookup(trace_state.cpu, pc, trace_state.head->cs_base,
+                              trace_state.head->flags, trace_state.cflags);
+        if (tb == NULL) {
+            return -1;
+        }
+    }
+    /* The TB must end with the branch, not have been cut short before it */
+    if (pc + tb->size != end) {
+        return -1;
+    }
+
+    n0 = qatomic_read(&tb->exit_count[0]);
+    n1 = qatomic_read(&tb->exit_count[1]);
+    if (n0 + n1 < TRACE_MIN_SAMPLES) {
+        return -1;
+    }
+    if (n0 * 8 >= (n0 + n1) * TRACE_BIAS) {
+        return 0;
+    }
+    if (n1 * 8 >= (n0 + n1) * TRACE_BIAS) {
+        return 1;
+    }
+    return -1;
+}
+
 /*
  * Isolate the portion of code gen which can setjmp/longjmp.
  * Return the size of the generated code, or negative on error.
@@ -295,10 +415,16 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
     int gen_code_size, search_size, max_insns;
     int64_t ti;
     void *host_pc;
+    bool tier_up;
 
     assert_memory_lock();
     qemu_thread_jit_write();
 
+    trace_state.active = trace_state.request;
+    trace_state.request = false;
+    tier_up = trace_state.tier_up;
+    trace_state.tier_up = false;
+
     phys_pc = get_page_addr_code_hostp(env, pc, &host_pc);
 
     if (phys_pc == -1) {
@@ -316,8 +442,8 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
     assert_no_pages_locked();
     tb = tcg_tb_alloc(tcg_ctx);
     if (unlikely(!tb)) {
-        /* flush must be done */
-        tb_flush(cpu);
+        /* eviction or flush must be done */
+        tb_evict(cpu);
         mmap_unlock();
         /* Make the execution loop process the flush as soon as possible.  */
         cpu->exception_index = EXCP_INTERRUPT;
@@ -338,7 +464,35 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
         tb_lock_page0(phys_pc);
     }
 
+    /*
+     * Profile the TB, unless it is a trace already or runs with a
+     * restricted execution mode (icount, single step...).  With tiering,
+     * a new TB is first translated quickly, without the optimizer, and
+     * counts down to its optimized translation.  That one, or any TB
+     * without tiering, counts down to its translation as a trace.
+     */
+    tb->trace_count = 0;
+    tb->profiled = false;
+    tb->tier0 = false;
+    if (!trace_state.active && phys_pc != -1 &&
+        !(cflags & (CF_COUNT_MASK | CF_NO_GOTO_TB | CF_NOIRQ |
+                    CF_USE_ICOUNT))) {
+        uint32_t tier_threshold = qatomic_read(&tcg_tier_threshold);
+
+        if (tier_threshold && !tier_up) {
+            tb->trace_count = tier_threshold;
+            tb->tier0 = true;
+        } else {
+            tb->trace_count = qatomic_read(&tcg_trace_threshold);
+        }
+        tb->profiled = tb->trace_count != 0;
+    }
+    tb->exit_count[0] = 0;
+    tb->exit_count[1] = 0;
+
     tcg_ctx->gen_tb = tb;
+    tcg_ctx->no_optimize = tb->tier0;
+    tcg_ctx->hot = trace_state.active || tier_up;
     tcg_ctx->addr_type = TARGET_LONG_BITS == 32 ? TCG_TYPE_I32 : TCG_TYPE_I64;
 #ifdef CONFIG_SOFTMMU
     tcg_ctx->page_bits = TARGET_PAGE_BITS;
@@ -652,14 +806,320 @@ void cpu_io_recompile(CPUState *cpu, uintptr_t retaddr)
  */
 void tcg_flush_jmp_cache(CPUState *cpu)
 {
-    CPUJumpCache *jc = cpu->tb_jmp_cache;
+    CPUJumpCache *jc;
+
+    RCU_READ_LOCK_GUARD();
+    jc = qatomic_rcu_read(&cpu->tb_jmp_cache);
 
     /* During early initialization, the cache may not yet be allocated. */
     if (unlikely(jc == NULL)) {
         return;
     }
 
-    for (int i = 0; i < TB_JMP_CACHE_SIZE; i++) {
+    for (int i = 0; i <= jc->mask; i++) {
         qatomic_set(&jc->array[i].tb, NULL);
     }
 }
+
+#ifndef CONFIG_USER_ONLY
+/*
+ * Persistent translation cache (-accel tcg,tb-cache=FILE).
+ *
+ * At exit, the lookup keys of the TBs translated from ROM and ROM devices
+ * are written to FILE; no host code is saved.  When the VM of a later run
+ * first starts, the guest code that they name is translated again before
+ * any vCPU runs, so that the firmware does not go through the translator
+ * bit by bit as it executes.  A key is only used if the guest bytes it was
+ * translated from are found unchanged, in a RAM block with the same name,
+ * at the same address for the CPU.
+ */
+
+#define TB_CACHE_MAGIC      "QEMUTBC"
+#define TB_CACHE_VERSION    4
+
+typedef struct TBCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t nb_entries;
+    char qemu_version[32];
+    char cpu_type[64];
+    uint32_t cpu_crc;
+    uint32_t entries_crc;
+} TBCacheHeader;
+
+typedef struct TBCacheEntry {
+    char idstr[256];        /* RAM block holding the guest code */
+    uint64_t offset;        /* guest code offset within the RAM block */
+    uint64_t pc;
+    uint64_t cs_base;
+    uint32_t flags;
+    uint32_t cflags;
+    uint32_t size;          /* guest code size */
+    uint32_t guest_crc;
+} TBCacheEntry;
+
+static struct {
+    char *path;
+    char cpu_type[64];
+    uint32_t cpu_crc;
+    TBCacheEntry *entries;
+    uint32_t nb_entries;
+    bool restored;
+    Notifier exit_notifier;
+    VMChangeStateEntry *vmse;
+} tb_cache;
+
+/*
+ * The configuration of all the CPUs, which translation depends on as much
+ * as on the CPU type.  False if a CPU cannot tell.
+ */
+static bool tb_cache_cpu_crc(uint32_t *crc)
+{
+    CPUState *cpu;
+
+    *crc = 0xffffffff;
+    CPU_FOREACH(cpu) {
+        const TCGCPUOps *ops = cpu->cc->tcg_ops;
+        uint32_t c;
+
+        if (!ops->config_crc) {
+            return false;
+        }
+        c = ops->config_crc(cpu);
+        *crc = crc32c(*crc, (const uint8_t *)&c, sizeof(c));
+    }
+    return true;
+}
+
+/* Checksum the guest code of a TB, if it lives in read-only memory */
+static bool tb_cache_guest_crc(RAMBlock *rb, ram_addr_t offset,
+                               unsigned size, uint32_t *crc)
+{
+    if (!memory_region_is_rom(rb->mr) && !memory_region_is_romd(rb->mr)) {
+        return false;
+    }
+    if (size > TARGET_PAGE_SIZE ||
+        offset + size > qemu_ram_get_used_length(rb)) {
+        return false;
+    }
+    *crc = crc32c(0xffffffff, ramblock_ptr(rb, offset), size);
+    return true;
+}
+
+/*
+ * The guest physical address of @offset in @rb.  This is what a CPU that
+ * runs the firmware with translation off uses as pc, which a CF_PCREL TB
+ * does not record.
+ */
+static bool tb_cache_guest_addr(RAMBlock *rb, ram_addr_t offset,
+                                uint64_t *addr)
+{
+    MemoryRegion *mr = rb->mr;
+
+    *addr = offset;
+    while (mr->container) {
+        *addr += mr->addr;
+        mr = mr->container;
+    }
+    return mr == get_system_memory();
+}
+
+static bool tb_cache_plugins_active(void)
+{
+#ifdef CONFIG_PLUGIN
+    return first_cpu && test_bit(QEMU_PLUGIN_EV_VCPU_TB_TRANS,
+                                 first_cpu->plugin_state->event_mask);
+#else
+    return false;
+#endif
+}
+
+static gboolean tb_cache_save_one(gpointer key, gpointer value, gpointer data)
+{
+    TranslationBlock *tb = value;
+    GArray *entries = data;
+    TBCacheEntry e = { };
+    ram_addr_t offset;
+    RAMBlock *rb;
+
+    if ((tb_cflags(tb) & CF_INVALID) ||
+        tb_page_addr0(tb) == -1 || tb_page_addr1(tb) != -1) {
+        return false;
+    }
+
+    rb = qemu_ram_block_from_host(qemu_map_ram_ptr(NULL, tb_page_addr0(tb)),
+                                  false, &offset);
+    if (!rb || !tb_cache_guest_crc(rb, offset, tb->size, &e.guest_crc)) {
+        return false;
+    }
+    if (tb_cflags(tb) & CF_PCREL) {
+        if (!tb_cache_guest_addr(rb, offset, &e.pc)) {
+            return false;
+        }
+    } else {
+        e.pc = tb->pc;
+    }
+
+    pstrcpy(e.idstr, sizeof(e.idstr), qemu_ram_get_idstr(rb));
+    e.offset = offset;
+    e.cs_base = tb->cs_base;
+    e.flags = tb->flags;
+    e.cflags = tb_cflags(tb);
+    e.size = tb->size;
+    g_array_append_val(entries, e);
+    return false;
+}
+
+static void tb_cache_save(Notifier *n, void *data)
+{
+    g_autoptr(GArray) entries = g_array_new(false, false,
+                                            sizeof(TBCacheEntry));
+    g_autoptr(GByteArray) buf = g_byte_array_new();
+    g_autoptr(GError) err = NULL;
+    TBCacheHeader hdr = { };
+
+    /* A cache that was accepted is left alone, so that runs are identical */
+    if (tb_cache.restored || !first_cpu || tb_cache_plugins_active() ||
+        !tb_cache_cpu_crc(&hdr.cpu_crc)) {
+        return;
+    }
+
+    WITH_RCU_READ_LOCK_GUARD() {
+        tcg_tb_foreach(tb_cache_save_one, entries);
+    }
+
+    memcpy(hdr.magic, TB_CACHE_MAGIC, sizeof(TB_CACHE_MAGIC));
+    hdr.version = TB_CACHE_VERSION;
+    hdr.nb_entries = entries->len;
+    pstrcpy(hdr.qemu_version, sizeof(hdr.qemu_version), QEMU_VERSION);
+    pstrcpy(hdr.cpu_type, sizeof(hdr.cpu_type),
+            object_get_typename(OBJECT(first_cpu)));
+    hdr.entries_crc = crc32c(0xffffffff, (const uint8_t *)entries->data,
+                             entries->len * sizeof(TBCacheEntry));
+
+    g_byte_array_append(buf, (const uint8_t *)&hdr, sizeof(hdr));
+    g_byte_array_append(buf, (const uint8_t *)entries->data,
+                        entries->len * sizeof(TBCacheEntry));
+
+    /* g_file_set_contents() renames a temporary file into place */
+    if (!g_file_set_contents(tb_cache.path, (const gchar *)buf->data,
+                             buf->len, &err)) {
+        warn_report("tb-cache: cannot write %s: %s", tb_cache.path,
+                    err->message);
+    }
+}
+
+/*
+ * Translate the cached entries whose guest code is unchanged, in the
+ * thread of the first vCPU while all of them are stopped, as tb_flush()
+ * does its work.  Stop at a quarter of the code buffer, so that
+ * tb_gen_code() never runs out of it here.
+ */
+static void tb_cache_warm(CPUState *cpu, run_on_cpu_data data)
+{
+    CPUArchState *env = cpu_env(cpu);
+    uint32_t cflags = curr_cflags(cpu);
+    size_t budget = tcg_code_capacity() / 4, used = 0;
+    uint32_t i, translated = 0;
+
+    WITH_RCU_READ_LOCK_GUARD() {
+        for (i = 0; i < tb_cache.nb_entries && used < budget; i++) {
+            TBCacheEntry *e = &tb_cache.entries[i];
+            RAMBlock *rb;
+            TranslationBlock *tb;
+            uint32_t crc;
+
+            e->idstr[sizeof(e->idstr) - 1] = 0;
+            rb = qemu_ram_block_by_name(e->idstr);
+            if (e->cflags != cflags || !rb ||
+                !tb_cache_guest_crc(rb, e->offset, e->size, &crc) ||
+                crc != e->guest_crc) {
+                continue;
+            }
+            /* The CPU must see the same bytes at pc, now */
+            if (get_page_addr_code(env, e->pc) !=
+                qemu_ram_get_offset(rb) + e->offset) {
+                continue;
+            }
+            if (tb_htable_lookup(cpu, e->pc, e->cs_base, e->flags, cflags)) {
+                continue;
+            }
+
+            mmap_lock();
+            tb = tb_gen_code(cpu, e->pc, e->cs_base, e->flags, cflags);
+            mmap_unlock();
+            used += tb->tc.size;
+            translated++;
+        }
+    }
+
+    trace_tb_cache_warm(tb_cache.path, translated, tb_cache.nb_entries);
+    g_free(tb_cache.entries);
+    tb_cache.entries = NULL;
+}
+
+static void tb_cache_start(void *opaque, bool running, RunState state)
+{
+    uint32_t cpu_crc;
+
+    if (!running) {
+        return;
+    }
+    qemu_del_vm_change_state_handler(tb_cache.vmse);
+    tb_cache.vmse = NULL;
+
+    if (strcmp(tb_cache.cpu_type, object_get_typename(OBJECT(first_cpu))) ||
+        !tb_cache_cpu_crc(&cpu_crc) || tb_cache.cpu_crc != cpu_crc ||
+        tb_cache_plugins_active()) {
+        warn_report("tb-cache: %s does not match this configuration",
+                    tb_cache.path);
+        g_free(tb_cache.entries);
+        tb_cache.entries = NULL;
+        return;
+    }
+
+    tb_cache.restored = true;
+    async_safe_run_on_cpu(first_cpu, tb_cache_warm, RUN_ON_CPU_NULL);
+}
+
+/*
+ * Read the cache, if there is one, and arrange for it to be rewritten at
+ * exit otherwise.  The entries are checked against the machine when the
+ * VM first starts running.
+ */
+void tb_cache_open(const char *path)
+{
+    g_autofree gchar *data = NULL;
+    const TBCacheHeader *hdr;
+    gsize len;
+
+    tb_cache.path = g_strdup(path);
+    tb_cache.exit_notifier.notify = tb_cache_save;
+    qemu_add_exit_notifier(&tb_cache.exit_notifier);
+
+    if (!g_file_get_contents(path, &data, &len, NULL)) {
+        /* First run: the cache is created at exit */
+        return;
+    }
+
+    hdr = (const TBCacheHeader *)data;
+    if (len < sizeof(*hdr) ||
+        memcmp(hdr->magic, TB_CACHE_MAGIC, sizeof(TB_CACHE_MAGIC)) ||
+        hdr->version != TB_CACHE_VERSION ||
+        strncmp(hdr->qemu_version, QEMU_VERSION, sizeof(hdr->qemu_version)) ||
+        len - sizeof(*hdr) != (gsize)hdr->nb_entries * sizeof(TBCacheEntry) ||
+        hdr->entries_crc != crc32c(0xffffffff, (const uint8_t *)(hdr + 1),
+                                   len - sizeof(*hdr))) {
+        warn_report("tb-cache: ignoring %s, it was not created by this "
+                    "binary", path);
+        return;
+    }
+
+    pstrcpy(tb_cache.cpu_type, sizeof(tb_cache.cpu_type), hdr->cpu_type);
+    tb_cache.cpu_crc = hdr->cpu_crc;
+    tb_cache.entries = g_memdup2(hdr + 1,
+                                 hdr->nb_entries * sizeof(TBCacheEntry));
+    tb_cache.nb_entries = hdr->nb_entries;
+    tb_cache.vmse = qemu_add_vm_change_state_handler(tb_cache_start, NULL);
+}
+#endif /* !CONFIG_USER_ONLY */
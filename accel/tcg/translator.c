@@ -16,6 +16,7 @@
 #include "exec/plugin-gen.h"
 #include "exec/cpu_ldst.h"
 #include "tcg/tcg-op-common.h"
+#include "internal-common.h"
 #include "internal-target.h"
 #include "disas/disas.h"
 
@@ -39,6 +40,24 @@ bool translator_io_start(DisasContextBase *db)
     return true;
 }
 
+/*
+ * Count down tb->trace_count and leave through the exit request path
+ * once it is no longer positive.  cpu_loop_exec_tb() then retranslates
+ * the TB with the optimizer (tier 0) or as a trace.  The signed test,
+ * rather than one for zero, keeps the TB hot when that exit is consumed
+ * by something else or when vCPUs race on the count.
+ */
+static void gen_trace_profile(TranslationBlock *tb)
+{
+    TCGv_ptr ptr = tcg_constant_ptr(&tb->trace_count);
+    TCGv_i32 count = tcg_temp_new_i32();
+
+    tcg_gen_ld_i32(count, ptr, 0);
+    tcg_gen_subi_i32(count, count, 1);
+    tcg_gen_st_i32(count, ptr, 0);
+    tcg_gen_brcondi_i32(TCG_COND_LE, count, 0, tcg_ctx->exitreq_label);
+}
+
 static TCGOp *gen_tb_start(DisasContextBase *db, uint32_t cflags)
 {
     TCGv_i32 count = NULL;
@@ -81,6 +100,11 @@ static TCGOp *gen_tb_start(DisasContextBase *db, uint32_t cflags)
                          - offsetof(ArchCPU, env));
     }
 
+    /* tb_gen_code() only profiles TBs without CF_NOIRQ. */
+    if (db->tb->profiled) {
+        gen_trace_profile(db->tb);
+    }
+
     return icount_start_insn;
 }
 
@@ -113,6 +137,32 @@ bool translator_use_goto_tb(DisasContextBase *db, vaddr dest)
     return ((db->pc_first ^ dest) & TARGET_PAGE_MASK) == 0;
 }
 
+void translator_trace_count_exit(DisasContextBase *db, int n)
+{
+    TranslationBlock *tb = db->tb;
+    TCGv_ptr ptr;
+    TCGv_i32 count;
+
+    if (!tb->profiled || tb->tier0) {
+        return;
+    }
+
+    ptr = tcg_constant_ptr(&tb->exit_count[n]);
+    count = tcg_temp_new_i32();
+    tcg_gen_ld_i32(count, ptr, 0);
+    tcg_gen_addi_i32(count, count, 1);
+    tcg_gen_st_i32(count, ptr, 0);
+}
+
+int translator_trace_hot_exit(DisasContextBase *db, vaddr pc, vaddr end)
+{
+    /* Plugins expect the guest insns of a TB to be contiguous. */
+    if (db->plugin_enabled) {
+        return -1;
+    }
+    return tb_trace_hot_exit(pc, end);
+}
+
 void translator_loop(CPUState *cpu, TranslationBlock *tb, int *max_insns,
                      vaddr pc, void *host_pc, const TranslatorOps *ops,
                      DisasContextBase *db)
@@ -86,6 +86,11 @@ struct PFlashCFI01 {
     void *storage;
     VMChangeStateEntry *vmstate;
     bool old_multiple_chip_handling;
+    bool xip;
+
+    /* Range of the array modified while the device was in I/O mode */
+    hwaddr dirty_start;
+    hwaddr dirty_end;
 
     /* block update buffer */
     unsigned char *blk_bytes;
@@ -261,6 +266,38 @@ static uint32_t pflash_data_read(PFlashCFI01 *pfl, hwaddr offset,
     return ret;
 }
 
+/*
+ * Note that the array was modified through pfl->storage.  Translated code
+ * cached from the array is invalidated when the device goes back to
+ * read array mode, since memory_region_flush_rom_device() only works on
+ * a ROM device in ROMD mode.
+ */
+static void pflash_mark_dirty(PFlashCFI01 *pfl, hwaddr offset, hwaddr size)
+{
+    if (pfl->dirty_start == pfl->dirty_end) {
+        pfl->dirty_start = offset;
+        pfl->dirty_end = offset + size;
+    } else {
+        pfl->dirty_start = MIN(pfl->dirty_start, offset);
+        pfl->dirty_end = MAX(pfl->dirty_end, offset + size);
+    }
+}
+
+/* Return to read array mode, making the array directly accessible again */
+static void pflash_mode_read_array(PFlashCFI01 *pfl)
+{
+    trace_pflash_mode_read_array(pfl->name);
+    memory_region_rom_device_set_romd(&pfl->mem, true);
+    pfl->wcycle = 0;
+    pfl->cmd = 0x00; /* This model reset value for READ_ARRAY (not CFI) */
+
+    if (pfl->dirty_start != pfl->dirty_end) {
+        memory_region_flush_rom_device(&pfl->mem, pfl->dirty_start,
+                                       pfl->dirty_end - pfl->dirty_start);
+        pfl->dirty_start = pfl->dirty_end = 0;
+    }
+}
+
 static uint32_t pflash_read(PFlashCFI01 *pfl, hwaddr offset,
                             int width, int be)
 {
@@ -310,6 +347,13 @@ static uint32_t pflash_read(PFlashCFI01 *pfl, hwaddr offset,
             ret |= pfl->status << 16;
         }
         trace_pflash_read_status(pfl->name, ret);
+        if (pfl->xip && pfl->wcycle == 0) {
+            /*
+             * In XIP mode the first status read after Read Status, or
+             * after a completed operation, goes back to read array.
+             */
+            pflash_mode_read_array(pfl);
+        }
         break;
     case 0x90:
         if (!pfl->device_width) {
@@ -389,6 +433,7 @@ static void pflash_update(PFlashCFI01 *pfl, int offset,
 {
     int offset_end;
     int ret;
+    pflash_mark_dirty(pfl, offset, size);
     if (pfl->blk) {
         offset_end = offset + size;
         /* widen to sector boundaries */
@@ -572,10 +617,7 @@ static void pflash_write(PFlashCFI01 *pfl, hwaddr offset,
             pfl->wcycle++;
             break;
         case 0x60:
-            if (cmd == 0xd0) {
-                pfl->wcycle = 0;
-                pfl->status |= 0x80;
-            } else if (cmd == 0x01) {
+            if (cmd == 0xd0 || cmd == 0x01) {
                 pfl->wcycle = 0;
                 pfl->status |= 0x80;
             } else if (cmd == 0xff) { /* Read Array */
@@ -653,10 +695,7 @@ static void pflash_write(PFlashCFI01 *pfl, hwaddr offset,
                   "\n", __func__, offset, pfl->wcycle, pfl->cmd, value);
 
  mode_read_array:
-    trace_pflash_mode_read_array(pfl->name);
-    memory_region_rom_device_set_romd(&pfl->mem, true);
-    pfl->wcycle = 0;
-    pfl->cmd = 0x00; /* This model reset value for READ_ARRAY (not CFI) */
+    pflash_mode_read_array(pfl);
 }
 
 
@@ -884,9 +923,7 @@ static void pflash_cfi01_system_reset(DeviceState *dev)
      * The command 0x00 is not assigned by the CFI open standard,
      * but QEMU historically uses it for the READ_ARRAY command (0xff).
      */
-    pfl->cmd = 0x00;
-    pfl->wcycle = 0;
-    memory_region_rom_device_set_romd(&pfl->mem, true);
+    pflash_mode_read_array(pfl);
     /*
      * The WSM ready timer occurs at most 150ns after system reset.
      * This model deliberately ignores this delay.
@@ -933,6 +970,16 @@ static Property pflash_cfi01_properties[] = {
     DEFINE_PROP_STRING("name", PFlashCFI01, name),
     DEFINE_PROP_BOOL("old-multiple-chip-handling", PFlashCFI01,
                      old_multiple_chip_handling, false),
+    /*
+     * In XIP (execute in place) mode the device goes back to read array
+     * mode after the first status read that follows a Read Status command
+     * or a completed program, erase or lock operation, as well as on Read
+     * Array.  Drivers polling the status still see it, errors included,
+     * but the array is mapped as ROMD memory again right after, so that
+     * TCG can execute guest code directly from it, for firmware which
+     * does not issue an explicit Read Array command.
+     */
+    DEFINE_PROP_BOOL("xip", PFlashCFI01, xip, false),
     DEFINE_PROP_END_OF_LIST(),
 };
 
@@ -220,15 +220,89 @@ static void serial_update_msl(SerialState *s)
     }
 }
 
+static void serial_tx_batch_flush(SerialState *s);
+
 static gboolean serial_watch_cb(void *do_not_use, GIOCondition cond,
                                 void *opaque)
 {
     SerialState *s = opaque;
     s->watch_tag = 0;
+    if (s->tx_batch) {
+        serial_tx_batch_flush(s);
+        if (!s->tsr_retry) {
+            return G_SOURCE_REMOVE;
+        }
+    }
     serial_xmit(s);
     return G_SOURCE_REMOVE;
 }
 
+/* Upper bound on how long a partial batch is held back */
+#define TX_BATCH_IDLE_NS (1 * SCALE_MS)
+
+/*
+ * Write as much of the batch as the chardev takes, and wait for it to be
+ * writable again for the rest.  As for single bytes, the rest is dropped
+ * if the chardev makes no progress after MAX_XMIT_RETRY attempts.
+ */
+static void serial_tx_batch_flush(SerialState *s)
+{
+    int rc;
+
+    if (s->tx_batch_timer) {
+        timer_del(s->tx_batch_timer);
+    }
+    if (!s->tx_batch_len || s->watch_tag > 0) {
+        return;
+    }
+
+    rc = qemu_chr_fe_write(&s->chr, s->tx_batch_buf, s->tx_batch_len);
+    if (rc > 0) {
+        s->tx_batch_len -= rc;
+        memmove(s->tx_batch_buf, s->tx_batch_buf + rc, s->tx_batch_len);
+        s->tx_batch_retry = 0;
+    }
+    if (!s->tx_batch_len) {
+        return;
+    }
+
+    if ((rc >= 0 || errno == EAGAIN) && s->tx_batch_retry < MAX_XMIT_RETRY) {
+        s->watch_tag = qemu_chr_fe_add_watch(&s->chr, G_IO_OUT | G_IO_HUP,
+                                             serial_watch_cb, s);
+        if (s->watch_tag > 0) {
+            s->tx_batch_retry++;
+            return;
+        }
+    }
+    s->tx_batch_len = 0;
+    s->tx_batch_retry = 0;
+}
+
+static void serial_tx_batch_timeout(void *opaque)
+{
+    serial_tx_batch_flush(opaque);
+}
+
+/* Returns false if the batch is full, until the chardev takes more. */
+static bool serial_tx_batch_push(SerialState *s, uint8_t ch)
+{
+    if (s->tx_batch_len == UART_TX_BATCH_LENGTH) {
+        serial_tx_batch_flush(s);
+        if (s->tx_batch_len == UART_TX_BATCH_LENGTH) {
+            return false;
+        }
+    }
+
+    s->tx_batch_buf[s->tx_batch_len++] = ch;
+    if (ch == '\n' || s->tx_batch_len == UART_TX_BATCH_LENGTH) {
+        serial_tx_batch_flush(s);
+    } else if (!timer_pending(s->tx_batch_timer)) {
+        timer_mod(s->tx_batch_timer,
+                  qemu_clock_get_ns(QEMU_CLOCK_REALTIME) + TX_BATCH_IDLE_NS);
+    }
+    return true;
+}
+
 static void serial_xmit(SerialState *s)
 {
     do {
@@ -255,6 +329,12 @@ static void serial_xmit(SerialState *s)
         if (s->mcr & UART_MCR_LOOP) {
             /* in loopback mode, say that we just received a char */
             serial_receive1(s, &s->tsr, 1);
+        } else if (s->tx_batch) {
+            if (!serial_tx_batch_push(s, s->tsr)) {
+                /* Keep the tsr until serial_watch_cb() makes room */
+                s->tsr_retry = 1;
+                return;
+            }
         } else {
             int rc = qemu_chr_fe_write(&s->chr, &s->tsr, 1);
 
@@ -633,6 +713,9 @@ static int serial_pre_save(void *opaque)
     SerialState *s = opaque;
     s->fcr_vmstate = s->fcr;
 
+    /* Whatever the chardev does not take now goes to serial/tx_batch */
+    serial_tx_batch_flush(s);
+
     return 0;
 }
 
@@ -679,6 +762,13 @@ static int serial_post_load(void *opaque, int version_id)
         }
     }
 
+    if (s->tx_batch_len > UART_TX_BATCH_LENGTH) {
+        error_report("inconsistent state in serial device "
+                     "(tx_batch_len=%u)", s->tx_batch_len);
+        return -1;
+    }
+    serial_tx_batch_flush(s);
+
     s->last_break_enable = (s->lcr >> 6) & 1;
     /* Initialize fcr via setter to perform essential side-effects */
     serial_write_fcr(s, s->fcr_vmstate);
@@ -732,6 +822,24 @@ static const VMStateDescription vmstate_serial_tsr = {
     }
 };
 
+static bool serial_tx_batch_needed(void *opaque)
+{
+    SerialState *s = (SerialState *)opaque;
+    return s->tx_batch_len != 0;
+}
+
+static const VMStateDescription vmstate_serial_tx_batch = {
+    .name = "serial/tx_batch",
+    .version_id = 1,
+    .minimum_version_id = 1,
+    .needed = serial_tx_batch_needed,
+    .fields = (const VMStateField[]) {
+        VMSTATE_UINT32(tx_batch_len, SerialState),
+        VMSTATE_UINT8_ARRAY(tx_batch_buf, SerialState, UART_TX_BATCH_LENGTH),
+        VMSTATE_END_OF_LIST()
+    }
+};
+
 static bool serial_recv_fifo_needed(void *opaque)
 {
     SerialState *s = (SerialState *)opaque;
@@ -847,6 +955,7 @@ const VMStateDescription vmstate_serial = {
         &vmstate_serial_fifo_timeout_timer,
         &vmstate_serial_timeout_ipending,
         &vmstate_serial_poll,
+        &vmstate_serial_tx_batch,
         NULL
     }
 };
@@ -859,6 +968,7 @@ static void serial_reset(void *opaque)
         g_source_remove(s->watch_tag);
         s->watch_tag = 0;
     }
+    serial_tx_batch_flush(s);
 
     s->rbr = 0;
     s->ier = 0;
@@ -926,6 +1036,11 @@ static void serial_realize(DeviceState *dev, Error **errp)
     s->modem_status_poll = timer_new_ns(QEMU_CLOCK_VIRTUAL, (QEMUTimerCB *) serial_update_msl, s);
 
     s->fifo_timeout_timer = timer_new_ns(QEMU_CLOCK_VIRTUAL, (QEMUTimerCB *) fifo_timeout_int, s);
+    if (s->tx_batch) {
+        /* Output must also come out while the VM is stopped */
+        s->tx_batch_timer = timer_new_ns(QEMU_CLOCK_REALTIME,
+                                         serial_tx_batch_timeout, s);
+    }
     qemu_register_reset(serial_reset, s);
 
     qemu_chr_fe_set_handlers(&s->chr, serial_can_receive1, serial_receive1,
@@ -939,12 +1054,22 @@ static void serial_unrealize(DeviceState *dev)
 {
     SerialState *s = SERIAL(dev);
 
+    serial_tx_batch_flush(s);
+    if (s->watch_tag > 0) {
+        g_source_remove(s->watch_tag);
+        s->watch_tag = 0;
+    }
     qemu_chr_fe_deinit(&s->chr, false);
 
     timer_free(s->modem_status_poll);
 
     timer_free(s->fifo_timeout_timer);
 
+    if (s->tx_batch_timer) {
+        timer_free(s->tx_batch_timer);
+        s->tx_batch_timer = NULL;
+    }
+
     fifo8_destroy(&s->recv_fifo);
     fifo8_destroy(&s->xmit_fifo);
 
@@ -975,6 +1100,7 @@ static Property serial_properties[] = {
     DEFINE_PROP_CHR("chardev", SerialState, chr),
     DEFINE_PROP_UINT32("baudbase", SerialState, baudbase, 115200),
     DEFINE_PROP_BOOL("wakeup", SerialState, wakeup, false),
+    DEFINE_PROP_BOOL("tx-batch", SerialState, tx_batch, false),
     DEFINE_PROP_END_OF_LIST(),
 };
 
@@ -30,7 +30,9 @@
 #include "hw/qdev-properties-system.h"
 #include "hw/sysbus.h"
 #include "qemu/module.h"
+#include "qemu/timer.h"
 #include "chardev/char-fe.h"
+#include "migration/vmstate.h"
 #include "qom/object.h"
 
 #define DUART(x)
@@ -54,6 +56,12 @@
 #define CONTROL_RST_RX    0x02
 #define CONTROL_IE        0x10
 
+/* Depth of the TX FIFO, and how long a partial batch may wait */
+#define TX_FIFO_SIZE      16
+#define TX_IDLE_NS        (1 * SCALE_MS)
+/* Times the chardev may take nothing before the FIFO is dropped */
+#define TX_MAX_RETRY      4
+
 struct XilinxUARTLite {
     SysBusDevice parent_obj;
 
@@ -65,9 +73,96 @@ struct XilinxUARTLite {
     unsigned int rx_fifo_pos;
     unsigned int rx_fifo_len;
 
+    /*
+     * Transmitted characters wait here until the chardev takes them.
+     * With tx-batch, they are only written to it when the FIFO fills up,
+     * on a newline or once the transmitter has been idle for TX_IDLE_NS.
+     */
+    bool tx_batch;
+    uint8_t tx_fifo[TX_FIFO_SIZE];
+    unsigned int tx_fifo_len;
+    unsigned int tx_retry;
+    guint tx_watch;
+    QEMUTimer *tx_timer;
+
     uint32_t regs[R_MAX];
 };
 
+static void uart_update_status(XilinxUARTLite *s);
+static void uart_tx_flush(XilinxUARTLite *s);
+
+static gboolean uart_tx_watch_cb(void *do_not_use, GIOCondition cond,
+                                 void *opaque)
+{
+    XilinxUARTLite *s = opaque;
+
+    s->tx_watch = 0;
+    uart_tx_flush(s);
+    uart_update_status(s);
+    return G_SOURCE_REMOVE;
+}
+
+/*
+ * Write as much of the FIFO as the chardev takes, and wait for it to be
+ * writable again for the rest.  The rest is dropped if the chardev makes
+ * no progress after TX_MAX_RETRY attempts.
+ */
+static void uart_tx_flush(XilinxUARTLite *s)
+{
+    int rc;
+
+    if (s->tx_timer) {
+        timer_del(s->tx_timer);
+    }
+    if (!s->tx_fifo_len || s->tx_watch > 0) {
+        return;
+    }
+
+    rc = qemu_chr_fe_write(&s->chr, s->tx_fifo, s->tx_fifo_len);
+    if (rc > 0) {
+        s->tx_fifo_len -= rc;
+        memmove(s->tx_fifo, s->tx_fifo + rc, s->tx_fifo_len);
+        s->tx_retry = 0;
+    }
+    if (!s->tx_fifo_len) {
+        return;
+    }
+
+    if ((rc >= 0 || errno == EAGAIN) && s->tx_retry < TX_MAX_RETRY) {
+        s->tx_watch = qemu_chr_fe_add_watch(&s->chr, G_IO_OUT | G_IO_HUP,
+                                            uart_tx_watch_cb, s);
+        if (s->tx_watch > 0) {
+            s->tx_retry++;
+            return;
+        }
+    }
+    s->tx_fifo_len = 0;
+    s->tx_retry = 0;
+}
+
+static void uart_tx_timeout(void *opaque)
+{
+    uart_tx_flush(opaque);
+}
+
+static void uart_tx(XilinxUARTLite *s, unsigned char ch)
+{
+    if (s->tx_fifo_len == TX_FIFO_SIZE) {
+        /* The guest ignored STATUS_TXFULL */
+        qemu_log_mask(LOG_GUEST_ERROR, "%s: TX FIFO full, dropping 0x%02x\n",
+                      __func__, ch);
+        return;
+    }
+
+    s->tx_fifo[s->tx_fifo_len++] = ch;
+    if (!s->tx_batch || ch == '\n' || s->tx_fifo_len == TX_FIFO_SIZE) {
+        uart_tx_flush(s);
+    } else if (!timer_pending(s->tx_timer)) {
+        timer_mod(s->tx_timer,
+                  qemu_clock_get_ns(QEMU_CLOCK_REALTIME) + TX_IDLE_NS);
+    }
+}
+
 static void uart_update_irq(XilinxUARTLite *s)
 {
     unsigned int irq;
@@ -84,8 +179,9 @@ static void uart_update_status(XilinxUARTLite *s)
     uint32_t r;
 
     r = s->regs[R_STATUS];
-    r &= ~7;
-    r |= 1 << 2; /* Tx fifo is always empty. We are fast :) */
+    r &= ~(7 | STATUS_TXFULL);
+    r |= s->tx_fifo_len ? 0 : STATUS_TXEMPTY;
+    r |= (s->tx_fifo_len == TX_FIFO_SIZE) ? STATUS_TXFULL : 0;
     r |= (s->rx_fifo_len == sizeof (s->rx_fifo)) << 1;
     r |= (!!s->rx_fifo_len);
     s->regs[R_STATUS] = r;
@@ -93,7 +189,10 @@ static void uart_update_status(XilinxUARTLite *s)
 
 static void xilinx_uartlite_reset(DeviceState *dev)
 {
-    uart_update_status(XILINX_UARTLITE(dev));
+    XilinxUARTLite *s = XILINX_UARTLITE(dev);
+
+    uart_tx_flush(s);
+    uart_update_status(s);
 }
 
 static uint64_t
@@ -143,13 +242,15 @@ uart_write(void *opaque, hwaddr addr,
                 s->rx_fifo_pos = 0;
                 s->rx_fifo_len = 0;
             }
+            if (value & CONTROL_RST_TX) {
+                /* Characters in the FIFO count as sent already */
+                uart_tx_flush(s);
+            }
             s->regs[addr] = value;
             break;
 
         case R_TX:
-            /* XXX this blocks entire thread. Rewrite to use
-             * qemu_chr_fe_write and background I/O callbacks */
-            qemu_chr_fe_write_all(&s->chr, &ch, 1);
+            uart_tx(s, ch);
             s->regs[addr] = value;
 
             /* hax.  */
@@ -178,6 +279,7 @@ static const MemoryRegionOps uart_ops = {
 
 static Property xilinx_uartlite_properties[] = {
     DEFINE_PROP_CHR("chardev", XilinxUARTLite, chr),
+    DEFINE_PROP_BOOL("tx-batch", XilinxUARTLite, tx_batch, false),
     DEFINE_PROP_END_OF_LIST(),
 };
 
@@ -211,12 +313,74 @@ static void uart_event(void *opaque, QEMUChrEvent event)
 
 }
 
+static int uart_pre_save(void *opaque)
+{
+    /* Whatever the chardev does not take now goes to uartlite/tx_fifo */
+    uart_tx_flush(opaque);
+    return 0;
+}
+
+static int uart_post_load(void *opaque, int version_id)
+{
+    XilinxUARTLite *s = opaque;
+
+    if (s->rx_fifo_len > sizeof(s->rx_fifo) ||
+        s->rx_fifo_pos >= sizeof(s->rx_fifo) ||
+        s->tx_fifo_len > TX_FIFO_SIZE) {
+        return -EINVAL;
+    }
+    uart_tx_flush(s);
+    return 0;
+}
+
+static bool uart_tx_fifo_needed(void *opaque)
+{
+    XilinxUARTLite *s = opaque;
+
+    return s->tx_fifo_len != 0;
+}
+
+static const VMStateDescription vmstate_uart_tx_fifo = {
+    .name = "uartlite/tx_fifo",
+    .version_id = 1,
+    .minimum_version_id = 1,
+    .needed = uart_tx_fifo_needed,
+    .fields = (const VMStateField[]) {
+        VMSTATE_UINT32(tx_fifo_len, XilinxUARTLite),
+        VMSTATE_UINT8_ARRAY(tx_fifo, XilinxUARTLite, TX_FIFO_SIZE),
+        VMSTATE_END_OF_LIST()
+    }
+};
+
+static const VMStateDescription vmstate_uart = {
+    .name = "uartlite",
+    .version_id = 1,
+    .minimum_version_id = 1,
+    .pre_save = uart_pre_save,
+    .post_load = uart_post_load,
+    .fields = (const VMStateField[]) {
+        VMSTATE_UINT32_ARRAY(regs, XilinxUARTLite, R_MAX),
+        VMSTATE_UINT8_ARRAY(rx_fifo, XilinxUARTLite, 8),
+        VMSTATE_UINT32(rx_fifo_pos, XilinxUARTLite),
+        VMSTATE_UINT32(rx_fifo_len, XilinxUARTLite),
+        VMSTATE_END_OF_LIST()
+    },
+    .subsections = (const VMStateDescription * const []) {
+        &vmstate_uart_tx_fifo,
+        NULL
+    }
+};
+
 static void xilinx_uartlite_realize(DeviceState *dev, Error **errp)
 {
     XilinxUARTLite *s = XILINX_UARTLITE(dev);
 
     qemu_chr_fe_set_handlers(&s->chr, uart_can_rx, uart_rx,
                              uart_event, NULL, s, NULL, true);
+
+    if (s->tx_batch) {
+        s->tx_timer = timer_new_ns(QEMU_CLOCK_REALTIME, uart_tx_timeout, s);
+    }
 }
 
 static void xilinx_uartlite_init(Object *obj)
@@ -236,6 +400,7 @@ static void xilinx_uartlite_class_init(ObjectClass *klass, void *data)
 
     dc->reset = xilinx_uartlite_reset;
     dc->realize = xilinx_uartlite_realize;
+    dc->vmsd = &vmstate_uart;
     device_class_set_props(dc, xilinx_uartlite_properties);
 }
 
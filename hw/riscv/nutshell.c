@@ -29,12 +29,14 @@
 #include "qemu/units.h"
 #include "qemu/log.h"
 #include "qemu/error-report.h"
+#include "qemu/guest-random.h"
 #include "qapi/error.h"
 #include "hw/boards.h"
 #include "hw/loader.h"
 #include "hw/sysbus.h"
 #include "hw/qdev-properties.h"
 #include "hw/char/serial.h"
+#include "hw/char/xilinx_uartlite.h"
 #include "target/riscv/cpu.h"
 #include "hw/riscv/riscv_hart.h"
 #include "hw/riscv/nutshell.h"
@@ -48,6 +50,9 @@
 #include "hw/intc/riscv_aclint.h"
 #include "hw/intc/sifive_plic.h"
 #include "hw/block/flash.h"
+#include "hw/qdev-properties-system.h"
+#include "hw/sd/nutshell_sdhost.h"
+#include "sysemu/block-backend.h"
 
 // refer src/main/scala/sim/SimMMIO.scala
 // refer src/main/scala/system/NutShell.scala
@@ -60,6 +65,7 @@ static const MemMapEntry memmap[] = {
     [NUTSHELL_UART0] = {0x10000000, 0x100},
     [NUTSHELL_UART1] = {0x10001000, 0x100},
     [NUTSHELL_UART2] = {0x10002000, 0x100},
+    [NUTSHELL_VIRTIO] = {0x10010000, 0x1000},
     [NUTSHELL_CLINT] = {0x38000000, 0x00010000},
     [NUTSHELL_PLIC] = {0x3c000000, 0x04000000},
     [NUTSHELL_FLASH] = {0x40000000, 0x1000},
@@ -69,61 +75,325 @@ static const MemMapEntry memmap[] = {
     [NUTSHELL_DRAM] = {0x80000000, 0x0}};
 
 
-static void nutshell_setup_rom_reset_vec(MachineState *machine,
-                                         RISCVHartArrayState *harts,
-                                         hwaddr start_addr, hwaddr rom_base,
-                                         hwaddr rom_size, uint64_t kernel_entry,
-                                         uint64_t fdt_load_addr) {
-  int i;
-  uint32_t start_addr_hi32 = 0x00000000;
-  uint32_t fdt_load_addr_hi32 = 0x00000000;
+static void create_fdt_cpus(NUTSHELLState *s, uint32_t *phandle,
+                            uint32_t *intc_phandles)
+{
+    MachineState *ms = MACHINE(s);
+    int socket, cpu, phandle_pos = ms->smp.cpus;
+    bool is_32_bit = riscv_is_32bit(&s->soc[0]);
+
+    qemu_fdt_add_subnode(ms->fdt, "/cpus");
+    qemu_fdt_setprop_cell(ms->fdt, "/cpus", "timebase-frequency",
+                          RISCV_ACLINT_DEFAULT_TIMEBASE_FREQ);
+    qemu_fdt_setprop_cell(ms->fdt, "/cpus", "#size-cells", 0x0);
+    qemu_fdt_setprop_cell(ms->fdt, "/cpus", "#address-cells", 0x1);
+    qemu_fdt_add_subnode(ms->fdt, "/cpus/cpu-map");
+
+    for (socket = riscv_socket_count(ms) - 1; socket >= 0; socket--) {
+        g_autofree char *clust_name = NULL;
+
+        phandle_pos -= s->soc[socket].num_harts;
+        clust_name = g_strdup_printf("/cpus/cpu-map/cluster%d", socket);
+        qemu_fdt_add_subnode(ms->fdt, clust_name);
+
+        for (cpu = s->soc[socket].num_harts - 1; cpu >= 0; cpu--) {
+            RISCVCPU *cpu_ptr = &s->soc[socket].harts[cpu];
+            int hartid = s->soc[socket].hartid_base + cpu;
+            uint32_t cpu_phandle = (*phandle)++;
+            uint32_t intc_phandle = (*phandle)++;
+            g_autofree char *cpu_name = NULL;
+            g_autofree char *core_name = NULL;
+            g_autofree char *intc_name = NULL;
+
+            cpu_name = g_strdup_printf("/cpus/cpu@%d", hartid);
+            qemu_fdt_add_subnode(ms->fdt, cpu_name);
+            if (cpu_ptr->cfg.satp_mode.supported != 0) {
+                uint8_t satp_mode_max =
+                    satp_mode_max_from_map(cpu_ptr->cfg.satp_mode.map);
+                g_autofree char *sv_name =
+                    g_strdup_printf("riscv,%s",
+                                    satp_mode_str(satp_mode_max, is_32_bit));
+
+                qemu_fdt_setprop_string(ms->fdt, cpu_name, "mmu-type",
+                                        sv_name);
+            }
+            riscv_isa_write_fdt(cpu_ptr, ms->fdt, cpu_name);
+            qemu_fdt_setprop_string(ms->fdt, cpu_name, "compatible", "riscv");
+            qemu_fdt_setprop_string(ms->fdt, cpu_name, "status", "okay");
+            qemu_fdt_setprop_cell(ms->fdt, cpu_name, "reg", hartid);
+            qemu_fdt_setprop_string(ms->fdt, cpu_name, "device_type", "cpu");
+            riscv_socket_fdt_write_id(ms, cpu_name, socket);
+            qemu_fdt_setprop_cell(ms->fdt, cpu_name, "phandle", cpu_phandle);
+
+            intc_phandles[phandle_pos + cpu] = intc_phandle;
+            intc_name = g_strdup_printf("%s/interrupt-controller", cpu_name);
+            qemu_fdt_add_subnode(ms->fdt, intc_name);
+            qemu_fdt_setprop_cell(ms->fdt, intc_name, "phandle", intc_phandle);
+            qemu_fdt_setprop_string(ms->fdt, intc_name, "compatible",
+                                    "riscv,cpu-intc");
+            qemu_fdt_setprop(ms->fdt, intc_name, "interrupt-controller",
+                             NULL, 0);
+            qemu_fdt_setprop_cell(ms->fdt, intc_name, "#interrupt-cells", 1);
+
+            core_name = g_strdup_printf("%s/core%d", clust_name, cpu);
+            qemu_fdt_add_subnode(ms->fdt, core_name);
+            qemu_fdt_setprop_cell(ms->fdt, core_name, "cpu", cpu_phandle);
+        }
+    }
+}
 
-  if (!riscv_is_32bit(harts)) {
-    start_addr_hi32 = start_addr >> 32;
-    fdt_load_addr_hi32 = fdt_load_addr >> 32;
-  }
-  /* reset vector */
-  uint32_t reset_vec[10] = {
-      0x00000297, /* 1:  auipc  t0, %pcrel_hi(fw_dyn) */
-      0x02828613, /*     addi   a2, t0, %pcrel_lo(1b) */
-      0xf1402573, /*     csrr   a0, mhartid  */
-      0,
-      0,
-      0x00028067, /*     jr     t0 */
-      start_addr, /* start: .dword */
-      start_addr_hi32,
-      fdt_load_addr, /* fdt_laddr: .dword */
-      fdt_load_addr_hi32,
-      /* fw_dyn: */
-  };
-  if (riscv_is_32bit(harts)) {
-    reset_vec[3] = 0x0202a583; /*     lw     a1, 32(t0) */
-    reset_vec[4] = 0x0182a283; /*     lw     t0, 24(t0) */
-  } else {
-    reset_vec[3] = 0x0202b583; /*     ld     a1, 32(t0) */
-    reset_vec[4] = 0x0182b283; /*     ld     t0, 24(t0) */
-  }
+static hwaddr nutshell_plic_socket_size(void)
+{
+    /* The PLIC window is shared out evenly between the sockets */
+    return memmap[NUTSHELL_PLIC].size / NUTSHELL_SOCKETS_MAX;
+}
 
-  if (!harts->harts[0].cfg.ext_zicsr) {
-    /*
-     * The Zicsr extension has been disabled, so let's ensure we don't
-     * run the CSR instruction. Let's fill the address with a non
-     * compressed nop.
-     */
-    reset_vec[2] = 0x00000013; /*     addi   x0, x0, 0 */
-  }
+static void create_fdt_socket_plic(NUTSHELLState *s, int socket,
+                                   uint32_t *phandle, uint32_t *intc_phandles,
+                                   uint32_t *plic_phandles)
+{
+    MachineState *ms = MACHINE(s);
+    g_autofree char *plic_name = NULL;
+    g_autofree uint32_t *plic_cells = NULL;
+    static const char * const plic_compat[2] = {
+        "sifive,plic-1.0.0", "riscv,plic0"
+    };
+    hwaddr plic_addr = memmap[NUTSHELL_PLIC].base +
+                       socket * nutshell_plic_socket_size();
+    int cpu;
+
+    plic_cells = g_new0(uint32_t, s->soc[socket].num_harts * 4);
+    for (cpu = 0; cpu < s->soc[socket].num_harts; cpu++) {
+        plic_cells[cpu * 4 + 0] = cpu_to_be32(intc_phandles[cpu]);
+        plic_cells[cpu * 4 + 1] = cpu_to_be32(IRQ_M_EXT);
+        plic_cells[cpu * 4 + 2] = cpu_to_be32(intc_phandles[cpu]);
+        plic_cells[cpu * 4 + 3] = cpu_to_be32(IRQ_S_EXT);
+    }
 
-  /* copy in the reset vector in little_endian byte order */
-  for (i = 0; i < ARRAY_SIZE(reset_vec); i++) {
-    reset_vec[i] = cpu_to_le32(reset_vec[i]);
-  }
+    plic_phandles[socket] = (*phandle)++;
+    plic_name = g_strdup_printf("/soc/plic@%lx", (long)plic_addr);
+    qemu_fdt_add_subnode(ms->fdt, plic_name);
+    qemu_fdt_setprop_cell(ms->fdt, plic_name, "#interrupt-cells", 1);
+    qemu_fdt_setprop_cell(ms->fdt, plic_name, "#address-cells", 0);
+    qemu_fdt_setprop_string_array(ms->fdt, plic_name, "compatible",
+                                  (char **)&plic_compat,
+                                  ARRAY_SIZE(plic_compat));
+    qemu_fdt_setprop(ms->fdt, plic_name, "interrupt-controller", NULL, 0);
+    qemu_fdt_setprop(ms->fdt, plic_name, "interrupts-extended", plic_cells,
+                     s->soc[socket].num_harts * sizeof(uint32_t) * 4);
+    qemu_fdt_setprop_cells(ms->fdt, plic_name, "reg",
+        0x0, plic_addr, 0x0, nutshell_plic_socket_size());
+    qemu_fdt_setprop_cell(ms->fdt, plic_name, "riscv,ndev",
+                          PLIC_NUM_SOURCES - 1);
+    riscv_socket_fdt_write_id(ms, plic_name, socket);
+    qemu_fdt_setprop_cell(ms->fdt, plic_name, "phandle",
+                          plic_phandles[socket]);
+}
+
+static void create_fdt_socket_memory(NUTSHELLState *s, int socket)
+{
+    MachineState *ms = MACHINE(s);
+    g_autofree char *mem_name = NULL;
+    uint64_t addr, size;
+
+    addr = memmap[NUTSHELL_DRAM].base + riscv_socket_mem_offset(ms, socket);
+    size = riscv_socket_mem_size(ms, socket);
+    mem_name = g_strdup_printf("/memory@%lx", (long)addr);
+    qemu_fdt_add_subnode(ms->fdt, mem_name);
+    qemu_fdt_setprop_cells(ms->fdt, mem_name, "reg",
+        addr >> 32, addr, size >> 32, size);
+    qemu_fdt_setprop_string(ms->fdt, mem_name, "device_type", "memory");
+    riscv_socket_fdt_write_id(ms, mem_name, socket);
+}
+
+static void create_fdt_sram(NUTSHELLState *s)
+{
+    MachineState *ms = MACHINE(s);
+    g_autofree char *name = NULL;
+
+    name = g_strdup_printf("/soc/sram@%lx", (long)memmap[NUTSHELL_SRAM].base);
+    qemu_fdt_add_subnode(ms->fdt, name);
+    qemu_fdt_setprop_string(ms->fdt, name, "compatible", "mmio-sram");
+    qemu_fdt_setprop_cells(ms->fdt, name, "reg",
+        0x0, memmap[NUTSHELL_SRAM].base, 0x0, memmap[NUTSHELL_SRAM].size);
+    qemu_fdt_setprop_cell(ms->fdt, name, "#address-cells", 1);
+    qemu_fdt_setprop_cell(ms->fdt, name, "#size-cells", 1);
+    qemu_fdt_setprop_cells(ms->fdt, name, "ranges",
+        0x0, 0x0, memmap[NUTSHELL_SRAM].base, memmap[NUTSHELL_SRAM].size);
+}
+
+static void create_fdt_socket_clint(NUTSHELLState *s, int socket,
+                                    uint32_t *intc_phandles)
+{
+    MachineState *ms = MACHINE(s);
+    g_autofree char *clint_name = NULL;
+    g_autofree uint32_t *clint_cells = NULL;
+    static const char * const clint_compat[2] = {
+        "sifive,clint0", "riscv,clint0"
+    };
+    hwaddr clint_addr = memmap[NUTSHELL_CLINT].base +
+                        socket * memmap[NUTSHELL_CLINT].size;
+    int cpu;
+
+    clint_cells = g_new0(uint32_t, s->soc[socket].num_harts * 4);
+    for (cpu = 0; cpu < s->soc[socket].num_harts; cpu++) {
+        clint_cells[cpu * 4 + 0] = cpu_to_be32(intc_phandles[cpu]);
+        clint_cells[cpu * 4 + 1] = cpu_to_be32(IRQ_M_SOFT);
+        clint_cells[cpu * 4 + 2] = cpu_to_be32(intc_phandles[cpu]);
+        clint_cells[cpu * 4 + 3] = cpu_to_be32(IRQ_M_TIMER);
+    }
+
+    clint_name = g_strdup_printf("/soc/clint@%lx", (long)clint_addr);
+    qemu_fdt_add_subnode(ms->fdt, clint_name);
+    qemu_fdt_setprop_string_array(ms->fdt, clint_name, "compatible",
+                                  (char **)&clint_compat,
+                                  ARRAY_SIZE(clint_compat));
+    qemu_fdt_setprop_cells(ms->fdt, clint_name, "reg",
+        0x0, clint_addr, 0x0, memmap[NUTSHELL_CLINT].size);
+    qemu_fdt_setprop(ms->fdt, clint_name, "interrupts-extended", clint_cells,
+                     s->soc[socket].num_harts * sizeof(uint32_t) * 4);
+    riscv_socket_fdt_write_id(ms, clint_name, socket);
+}
+
+static void create_fdt_uart(NUTSHELLState *s, int uart, int irq,
+                            uint32_t plic_phandle)
+{
+    MachineState *ms = MACHINE(s);
+    g_autofree char *name = NULL;
+
+    name = g_strdup_printf("/soc/serial@%lx", (long)memmap[uart].base);
+    qemu_fdt_add_subnode(ms->fdt, name);
+    qemu_fdt_setprop_string(ms->fdt, name, "compatible", "ns16550a");
+    qemu_fdt_setprop_cells(ms->fdt, name, "reg",
+        0x0, memmap[uart].base, 0x0, memmap[uart].size);
+    qemu_fdt_setprop_cell(ms->fdt, name, "clock-frequency", 3686400);
+    qemu_fdt_setprop_cell(ms->fdt, name, "interrupt-parent", plic_phandle);
+    qemu_fdt_setprop_cell(ms->fdt, name, "interrupts", irq);
+
+    if (uart == NUTSHELL_UART0) {
+        qemu_fdt_setprop_string(ms->fdt, "/chosen", "stdout-path", name);
+    }
+}
+
+static void create_fdt_uartlite(NUTSHELLState *s, uint32_t plic_phandle)
+{
+    MachineState *ms = MACHINE(s);
+    g_autofree char *name = NULL;
+
+    name = g_strdup_printf("/soc/serial@%lx",
+                           (long)memmap[NUTSHELL_UARTLITE].base);
+    qemu_fdt_add_subnode(ms->fdt, name);
+    qemu_fdt_setprop_string(ms->fdt, name, "compatible",
+                            "xlnx,xps-uartlite-1.00.a");
+    qemu_fdt_setprop_cells(ms->fdt, name, "reg",
+        0x0, memmap[NUTSHELL_UARTLITE].base,
+        0x0, memmap[NUTSHELL_UARTLITE].size);
+    qemu_fdt_setprop_cell(ms->fdt, name, "current-speed", 115200);
+    qemu_fdt_setprop_cell(ms->fdt, name, "interrupt-parent", plic_phandle);
+    qemu_fdt_setprop_cell(ms->fdt, name, "interrupts", UARTLITE_IRQ);
+}
+
+static void create_fdt_flash(NUTSHELLState *s)
+{
+    MachineState *ms = MACHINE(s);
+    g_autofree char *name = NULL;
+
+    name = g_strdup_printf("/flash@%lx", (long)memmap[NUTSHELL_FLASH].base);
+    qemu_fdt_add_subnode(ms->fdt, name);
+    qemu_fdt_setprop_string(ms->fdt, name, "compatible", "cfi-flash");
+    qemu_fdt_setprop_cells(ms->fdt, name, "reg",
+        0x0, memmap[NUTSHELL_FLASH].base, 0x0, memmap[NUTSHELL_FLASH].size);
+    qemu_fdt_setprop_cell(ms->fdt, name, "bank-width", 4);
+}
+
+static void create_fdt_virtio(NUTSHELLState *s, uint32_t plic_phandle)
+{
+    MachineState *ms = MACHINE(s);
+    int i;
+
+    for (i = 0; i < VIRTIO_COUNT; i++) {
+        hwaddr base = memmap[NUTSHELL_VIRTIO].base +
+                      i * memmap[NUTSHELL_VIRTIO].size;
+        g_autofree char *name = g_strdup_printf("/soc/virtio_mmio@%lx",
+                                                (long)base);
+
+        qemu_fdt_add_subnode(ms->fdt, name);
+        qemu_fdt_setprop_string(ms->fdt, name, "compatible", "virtio,mmio");
+        qemu_fdt_setprop_cells(ms->fdt, name, "reg",
+            0x0, base, 0x0, memmap[NUTSHELL_VIRTIO].size);
+        qemu_fdt_setprop_cell(ms->fdt, name, "interrupt-parent",
+                              plic_phandle);
+        qemu_fdt_setprop_cell(ms->fdt, name, "interrupts", VIRTIO_IRQ + i);
+    }
+}
+
+static void create_fdt(NUTSHELLState *s)
+{
+    MachineState *ms = MACHINE(s);
+    uint32_t phandle = 1, plic_phandle;
+    uint32_t plic_phandles[NUTSHELL_SOCKETS_MAX];
+    g_autofree uint32_t *intc_phandles = NULL;
+    uint8_t rng_seed[32];
+    int socket, phandle_pos;
+
+    ms->fdt = create_device_tree(&s->fdt_size);
+    if (!ms->fdt) {
+        error_report("create_device_tree() failed");
+        exit(1);
+    }
+
+    qemu_fdt_setprop_string(ms->fdt, "/", "model", "riscv-nutshell,qemu");
+    qemu_fdt_setprop_string(ms->fdt, "/", "compatible", "riscv-nutshell");
+    qemu_fdt_setprop_cell(ms->fdt, "/", "#size-cells", 0x2);
+    qemu_fdt_setprop_cell(ms->fdt, "/", "#address-cells", 0x2);
+
+    qemu_fdt_add_subnode(ms->fdt, "/soc");
+    qemu_fdt_setprop(ms->fdt, "/soc", "ranges", NULL, 0);
+    qemu_fdt_setprop_string(ms->fdt, "/soc", "compatible", "simple-bus");
+    qemu_fdt_setprop_cell(ms->fdt, "/soc", "#size-cells", 0x2);
+    qemu_fdt_setprop_cell(ms->fdt, "/soc", "#address-cells", 0x2);
+
+    qemu_fdt_add_subnode(ms->fdt, "/chosen");
+
+    /* Pass seed to RNG */
+    qemu_guest_getrandom_nofail(rng_seed, sizeof(rng_seed));
+    qemu_fdt_setprop(ms->fdt, "/chosen", "rng-seed",
+                     rng_seed, sizeof(rng_seed));
+
+    intc_phandles = g_new0(uint32_t, ms->smp.cpus);
+    create_fdt_cpus(s, &phandle, intc_phandles);
+
+    phandle_pos = 0;
+    for (socket = 0; socket < riscv_socket_count(ms); socket++) {
+        create_fdt_socket_memory(s, socket);
+        create_fdt_socket_clint(s, socket, &intc_phandles[phandle_pos]);
+        create_fdt_socket_plic(s, socket, &phandle,
+                               &intc_phandles[phandle_pos], plic_phandles);
+        phandle_pos += s->soc[socket].num_harts;
+    }
+    riscv_socket_fdt_write_distance_matrix(ms);
+
+    /* All on-chip peripherals are wired to the PLIC of socket 0 */
+    plic_phandle = plic_phandles[0];
+
+    create_fdt_sram(s);
+    create_fdt_flash(s);
+
+    create_fdt_uart(s, NUTSHELL_UART2, UART2_IRQ, plic_phandle);
+    create_fdt_uart(s, NUTSHELL_UART1, UART1_IRQ, plic_phandle);
+    create_fdt_uart(s, NUTSHELL_UART0, UART0_IRQ, plic_phandle);
+    create_fdt_uartlite(s, plic_phandle);
+
+    if (s->virtio_mmio) {
+        create_fdt_virtio(s, plic_phandle);
+    }
 }
 
 static void nutshell_flash_create(MachineState *machine)
 { 
     MemoryRegion *system_memory = get_system_memory();
     NUTSHELLState *s = RISCV_NUTSHELL_MACHINE(machine);
-    uint64_t flash_sector_size = 256 * KiB;
+    uint64_t flash_sector_size = 4 * KiB;
     DeviceState *dev = qdev_new(TYPE_PFLASH_CFI01);
 
     qdev_prop_set_uint64(dev, "sector-length", flash_sector_size);
@@ -135,6 +405,12 @@ static void nutshell_flash_create(MachineState *machine)
     qdev_prop_set_uint16(dev, "id2", 0x00);
     qdev_prop_set_uint16(dev, "id3", 0x00);
     qdev_prop_set_string(dev, "name", "nutshell.flash0");
+    /*
+     * The reset vector jumps straight into the flash, so keep it in read
+     * array mode as much as possible: TCG then executes the firmware
+     * in place instead of going through MMIO for every fetch.
+     */
+    qdev_prop_set_bit(dev, "xip", true);
     object_property_add_child(OBJECT(s), "nutshell.flash0", OBJECT(dev));
     object_property_add_alias(OBJECT(s), "pflash0",
                               OBJECT(dev), "drive");
@@ -153,48 +429,118 @@ static void nutshell_flash_create(MachineState *machine)
                             sysbus_mmio_get_region(SYS_BUS_DEVICE(dev), 0));
 }
 
+static void nutshell_sd_create(MachineState *machine)
+{
+    NUTSHELLState *s = RISCV_NUTSHELL_MACHINE(machine);
+    DriveInfo *dinfo = drive_get(IF_SD, 0, 0);
+    BlockBackend *blk = dinfo ? blk_by_legacy_dinfo(dinfo) : NULL;
+    DeviceState *card_dev;
+    SysBusDevice *sbd;
+
+    s->sdhost = qdev_new(TYPE_NUTSHELL_SDHOST);
+    object_property_add_child(OBJECT(s), "sdhost", OBJECT(s->sdhost));
+    object_property_set_link(OBJECT(s->sdhost), "dma-memory",
+                             OBJECT(get_system_memory()), &error_abort);
+    sbd = SYS_BUS_DEVICE(s->sdhost);
+    sysbus_realize_and_unref(sbd, &error_fatal);
+    sysbus_mmio_map(sbd, 0, memmap[NUTSHELL_SD].base);
+    sysbus_mmio_map(sbd, 1, memmap[NUTSHELL_DMA].base);
+    sysbus_connect_irq(sbd, 0, qdev_get_gpio_in(DEVICE(s->plic[0]), SD_IRQ));
+
+    card_dev = qdev_new(TYPE_SD_CARD);
+    qdev_prop_set_drive_err(card_dev, "drive", blk, &error_fatal);
+    qdev_realize_and_unref(card_dev, qdev_get_child_bus(s->sdhost, "sd-bus"),
+                           &error_fatal);
+}
+
+static void nutshell_virtio_create(MachineState *machine)
+{
+    NUTSHELLState *s = RISCV_NUTSHELL_MACHINE(machine);
+    int i;
+
+    if (!s->virtio_mmio) {
+        return;
+    }
+
+    for (i = 0; i < VIRTIO_COUNT; i++) {
+        sysbus_create_simple("virtio-mmio",
+            memmap[NUTSHELL_VIRTIO].base + i * memmap[NUTSHELL_VIRTIO].size,
+            qdev_get_gpio_in(DEVICE(s->plic[0]), VIRTIO_IRQ + i));
+    }
+}
+
 static void nutshell_interrupt_controller_create(MachineState *machine) {
     NUTSHELLState *s = RISCV_NUTSHELL_MACHINE(machine);
-    char *plic_hart_config;
-
-    riscv_aclint_swi_create(
-        memmap[NUTSHELL_CLINT].base,
-        0, machine->smp.cpus, false);
-    riscv_aclint_mtimer_create(memmap[NUTSHELL_CLINT].base + RISCV_ACLINT_SWI_SIZE,
-        RISCV_ACLINT_DEFAULT_MTIMER_SIZE, 0, machine->smp.cpus,
-        RISCV_ACLINT_DEFAULT_MTIMECMP, RISCV_ACLINT_DEFAULT_MTIME,
-        RISCV_ACLINT_DEFAULT_TIMEBASE_FREQ, true);
-
-    plic_hart_config = riscv_plic_hart_config_string(machine->smp.cpus);
-    s->plic = sifive_plic_create(
-        memmap[NUTSHELL_PLIC].base,
-        plic_hart_config,  machine->smp.cpus, 0,
-        PLIC_NUM_SOURCES,
-        PLIC_NUM_PRIORITIES,
-        PLIC_PRIORITY_BASE,
-        PLIC_PENDING_BASE,
-        PLIC_ENABLE_BASE,
-        PLIC_ENABLE_STRIDE,
-        PLIC_CONTEXT_BASE,
-        PLIC_CONTEXT_STRIDE,
-        memmap[NUTSHELL_PLIC].size);
-    g_free(plic_hart_config);
+    int i, base_hartid, hart_count;
+
+    for (i = 0; i < riscv_socket_count(machine); i++) {
+        g_autofree char *plic_hart_config = NULL;
+        hwaddr clint_base = memmap[NUTSHELL_CLINT].base +
+                            i * memmap[NUTSHELL_CLINT].size;
+
+        base_hartid = riscv_socket_first_hartid(machine, i);
+        hart_count = riscv_socket_hart_count(machine, i);
+
+        /* Per-socket ACLINT MSWI and MTIMER */
+        riscv_aclint_swi_create(clint_base, base_hartid, hart_count, false);
+        riscv_aclint_mtimer_create(clint_base + RISCV_ACLINT_SWI_SIZE,
+            RISCV_ACLINT_DEFAULT_MTIMER_SIZE, base_hartid, hart_count,
+            RISCV_ACLINT_DEFAULT_MTIMECMP, RISCV_ACLINT_DEFAULT_MTIME,
+            RISCV_ACLINT_DEFAULT_TIMEBASE_FREQ, true);
+
+        /* Per-socket PLIC */
+        plic_hart_config = riscv_plic_hart_config_string(hart_count);
+        s->plic[i] = sifive_plic_create(
+            memmap[NUTSHELL_PLIC].base + i * nutshell_plic_socket_size(),
+            plic_hart_config, hart_count, base_hartid,
+            PLIC_NUM_SOURCES,
+            PLIC_NUM_PRIORITIES,
+            PLIC_PRIORITY_BASE,
+            PLIC_PENDING_BASE,
+            PLIC_ENABLE_BASE,
+            PLIC_ENABLE_STRIDE,
+            PLIC_CONTEXT_BASE,
+            PLIC_CONTEXT_STRIDE,
+            nutshell_plic_socket_size());
+    }
+}
+
+/* Like serial_mm_init(), but lets the board choose tx-batch */
+static void nutshell_uart_create(NUTSHELLState *s, int uart, int irq,
+                                 Chardev *chr)
+{
+    DeviceState *dev = qdev_new(TYPE_SERIAL_MM);
+    SysBusDevice *sbd = SYS_BUS_DEVICE(dev);
+
+    qdev_prop_set_uint8(dev, "regshift", 0);
+    qdev_prop_set_uint32(dev, "baudbase", 399193);
+    qdev_prop_set_chr(dev, "chardev", chr);
+    qdev_prop_set_bit(dev, "tx-batch", s->uart_tx_batch);
+    qdev_set_legacy_instance_id(dev, memmap[uart].base, 2);
+    qdev_prop_set_uint8(dev, "endianness", DEVICE_LITTLE_ENDIAN);
+    sysbus_realize_and_unref(sbd, &error_fatal);
+
+    sysbus_connect_irq(sbd, 0, qdev_get_gpio_in(DEVICE(s->plic[0]), irq));
+    memory_region_add_subregion(get_system_memory(), memmap[uart].base,
+                                sysbus_mmio_get_region(sbd, 0));
 }
 
 static void nutshell_serial_create(MachineState *machine)
-{    
-    MemoryRegion *system_memory = get_system_memory();
+{
     NUTSHELLState *s = RISCV_NUTSHELL_MACHINE(machine);
+    DeviceState *dev;
+
+    nutshell_uart_create(s, NUTSHELL_UART0, UART0_IRQ, serial_hd(0));
+    nutshell_uart_create(s, NUTSHELL_UART1, UART1_IRQ, serial_hd(1));
+    nutshell_uart_create(s, NUTSHELL_UART2, UART2_IRQ, serial_hd(2));
 
-    serial_mm_init(system_memory, memmap[NUTSHELL_UART0].base,
-        0, qdev_get_gpio_in(DEVICE(s->plic), UART0_IRQ), 399193,
-        serial_hd(0), DEVICE_LITTLE_ENDIAN);
-    serial_mm_init(system_memory, memmap[NUTSHELL_UART1].base,
-        0, qdev_get_gpio_in(DEVICE(s->plic), UART1_IRQ), 399193,
-        serial_hd(1), DEVICE_LITTLE_ENDIAN);
-    serial_mm_init(system_memory, memmap[NUTSHELL_UART2].base,
-        0, qdev_get_gpio_in(DEVICE(s->plic), UART2_IRQ), 399193,
-        serial_hd(2), DEVICE_LITTLE_ENDIAN);
+    dev = qdev_new(TYPE_XILINX_UARTLITE);
+    qdev_prop_set_chr(dev, "chardev", serial_hd(3));
+    qdev_prop_set_bit(dev, "tx-batch", s->uart_tx_batch);
+    sysbus_realize_and_unref(SYS_BUS_DEVICE(dev), &error_fatal);
+    sysbus_mmio_map(SYS_BUS_DEVICE(dev), 0, memmap[NUTSHELL_UARTLITE].base);
+    sysbus_connect_irq(SYS_BUS_DEVICE(dev), 0,
+                       qdev_get_gpio_in(DEVICE(s->plic[0]), UARTLITE_IRQ));
 }
 
 static void nutshell_cpu_create(MachineState *machine) {
@@ -237,21 +583,24 @@ static void nutshell_cpu_create(MachineState *machine) {
                             &error_abort);
     object_property_set_int(OBJECT(&s->soc[i]), "num-harts", hart_count,
                             &error_abort);
+    object_property_set_int(OBJECT(&s->soc[i]), "resetvec",
+                            memmap[NUTSHELL_MROM].base, &error_abort);
     sysbus_realize(SYS_BUS_DEVICE(&s->soc[i]), &error_abort);
   }
 }
 
 static void nutshell_memory_create(MachineState *machine) {
-  NUTSHELLState *s = RISCV_NUTSHELL_MACHINE(machine);
   MemoryRegion *system_memory = get_system_memory();
-  MemoryRegion *main_mem = g_new(MemoryRegion, 1);
   MemoryRegion *sram_mem = g_new(MemoryRegion, 1);
   MemoryRegion *mask_rom = g_new(MemoryRegion, 1);
 
-  memory_region_init_ram(main_mem, NULL, "riscv_nutshell_board.dram",
-                         machine->ram_size, &error_fatal);
+  /*
+   * machine->ram is either a single backend or, with -numa node,memdev=...,
+   * a container holding the backend of each node in order; the sockets'
+   * DRAM ranges reported to the guest follow the same layout.
+   */
   memory_region_add_subregion(system_memory, memmap[NUTSHELL_DRAM].base,
-                              main_mem);
+                              machine->ram);
 
   memory_region_init_ram(sram_mem, NULL, "riscv_nutshell_board.sram",
                          memmap[NUTSHELL_SRAM].size, &error_fatal);
@@ -262,23 +611,104 @@ static void nutshell_memory_create(MachineState *machine) {
                          memmap[NUTSHELL_MROM].size, &error_fatal);
   memory_region_add_subregion(system_memory, memmap[NUTSHELL_MROM].base,
                               mask_rom);
+}
+
+static void nutshell_boot(MachineState *machine)
+{
+    NUTSHELLState *s = RISCV_NUTSHELL_MACHINE(machine);
+    hwaddr start_addr = memmap[NUTSHELL_FLASH].base;
+    target_ulong firmware_end_addr, kernel_start_addr;
+    uint64_t kernel_entry = 0;
+    uint64_t fdt_load_addr;
+
+    /*
+     * Without -bios or -kernel keep running the firmware stored in the CFI
+     * flash.  Otherwise boot directly from DRAM: load the firmware there
+     * (OpenSBI unless -bios says otherwise) followed by the kernel.
+     */
+    if (machine->kernel_filename ||
+        (machine->firmware && strcmp(machine->firmware, "none"))) {
+        start_addr = memmap[NUTSHELL_DRAM].base;
+        firmware_end_addr = riscv_find_and_load_firmware(machine,
+                                riscv_default_firmware_name(&s->soc[0]),
+                                start_addr, NULL);
+
+        if (machine->kernel_filename) {
+            kernel_start_addr = riscv_calc_kernel_start_addr(&s->soc[0],
+                                                        firmware_end_addr);
+            kernel_entry = riscv_load_kernel(machine, &s->soc[0],
+                                             kernel_start_addr, true, NULL);
+        }
+    }
+
+    fdt_load_addr = riscv_compute_fdt_addr(memmap[NUTSHELL_DRAM].base,
+                                           memmap[NUTSHELL_DRAM].size,
+                                           machine);
+    riscv_load_fdt(fdt_load_addr, machine->fdt);
 
-  nutshell_setup_rom_reset_vec(machine, &s->soc[0], memmap[NUTSHELL_FLASH].base,
-                               memmap[NUTSHELL_MROM].base,
-                               memmap[NUTSHELL_MROM].size, 0, 0);
+    /* load the reset vector */
+    riscv_setup_rom_reset_vec(machine, &s->soc[0], start_addr,
+                              memmap[NUTSHELL_MROM].base,
+                              memmap[NUTSHELL_MROM].size, kernel_entry,
+                              fdt_load_addr);
 }
 
 
 static void nutshell_machine_init(MachineState *machine) {
+  NUTSHELLState *s = RISCV_NUTSHELL_MACHINE(machine);
+
   nutshell_cpu_create(machine);
   nutshell_interrupt_controller_create(machine);
   nutshell_memory_create(machine);
   nutshell_flash_create(machine);
   nutshell_serial_create(machine);
+  nutshell_sd_create(machine);
+  nutshell_virtio_create(machine);
+
+  /* load/create device tree */
+  if (machine->dtb) {
+    machine->fdt = load_device_tree(machine->dtb, &s->fdt_size);
+    if (!machine->fdt) {
+      error_report("load_device_tree() failed");
+      exit(1);
+    }
+  } else {
+    create_fdt(s);
+  }
+
+  nutshell_boot(machine);
 }
 
 
 
+static bool nutshell_get_virtio_mmio(Object *obj, Error **errp)
+{
+    NUTSHELLState *s = RISCV_NUTSHELL_MACHINE(obj);
+
+    return s->virtio_mmio;
+}
+
+static void nutshell_set_virtio_mmio(Object *obj, bool value, Error **errp)
+{
+    NUTSHELLState *s = RISCV_NUTSHELL_MACHINE(obj);
+
+    s->virtio_mmio = value;
+}
+
+static bool nutshell_get_uart_tx_batch(Object *obj, Error **errp)
+{
+    NUTSHELLState *s = RISCV_NUTSHELL_MACHINE(obj);
+
+    return s->uart_tx_batch;
+}
+
+static void nutshell_set_uart_tx_batch(Object *obj, bool value, Error **errp)
+{
+    NUTSHELLState *s = RISCV_NUTSHELL_MACHINE(obj);
+
+    s->uart_tx_batch = value;
+}
+
 static void nutshell_machine_class_init(ObjectClass *oc, void *data) {
   MachineClass *mc = MACHINE_CLASS(oc);
 
@@ -292,6 +722,20 @@ static void nutshell_machine_class_init(ObjectClass *oc, void *data) {
   mc->cpu_index_to_instance_props = riscv_numa_cpu_index_to_props;
   mc->get_default_cpu_node_id = riscv_numa_get_default_cpu_node_id;
   mc->numa_mem_supported = true;
+  mc->default_ram_id = "riscv_nutshell_board.dram";
+
+  object_class_property_add_bool(oc, "virtio-mmio", nutshell_get_virtio_mmio,
+                                 nutshell_set_virtio_mmio);
+  object_class_property_set_description(oc, "virtio-mmio",
+                                        "Set on/off to enable/disable the "
+                                        "virtio-mmio transports");
+
+  object_class_property_add_bool(oc, "uart-tx-batch",
+                                 nutshell_get_uart_tx_batch,
+                                 nutshell_set_uart_tx_batch);
+  object_class_property_set_description(oc, "uart-tx-batch",
+                                        "Set on/off to batch UART output "
+                                        "written to the character devices");
 }
 
 static void nutshell_machine_instance_init(Object *obj) {}
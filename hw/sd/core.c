@@ -123,8 +123,13 @@ void sdbus_write_data(SDBus *sdbus, const void *buf, size_t length)
 
     if (card) {
         SDCardClass *sc = SDMMC_COMMON_GET_CLASS(card);
+        size_t done = 0;
 
-        for (size_t i = 0; i < length; i++) {
+        if (sc->write_blocks) {
+            done = sc->write_blocks(card, data, length);
+            trace_sdbus_write_blocks(sdbus_name(sdbus), done);
+        }
+        for (size_t i = done; i < length; i++) {
             trace_sdbus_write(sdbus_name(sdbus), data[i]);
             sc->write_byte(card, data[i]);
         }
@@ -153,8 +158,13 @@ void sdbus_read_data(SDBus *sdbus, void *buf, size_t length)
 
     if (card) {
         SDCardClass *sc = SDMMC_COMMON_GET_CLASS(card);
+        size_t done = 0;
 
-        for (size_t i = 0; i < length; i++) {
+        if (sc->read_blocks) {
+            done = sc->read_blocks(card, data, length);
+            trace_sdbus_read_blocks(sdbus_name(sdbus), done);
+        }
+        for (size_t i = done; i < length; i++) {
             data[i] = sc->read_byte(card);
             trace_sdbus_read(sdbus_name(sdbus), data[i]);
         }
@@ -0,0 +1,589 @@
+/*
+ * NutShell SD Host Controller and DMA engine
+ *
+ * The SD host uses the same register layout as the BCM2835 SDHOST block,
+ * which is what the NutShell SoC (and its NEMU reference model) exposes to
+ * software.  Besides the programmed I/O data port, a companion DMA engine
+ * moves whole blocks between the card and guest memory.  DMA transfers map
+ * guest RAM with dma_memory_map() and hand the host pointer to the SD bus,
+ * so that multiple block transfers go directly between the block backend
+ * and guest memory without an intermediate copy.
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/log.h"
+#include "qemu/module.h"
+#include "qemu/units.h"
+#include "qapi/error.h"
+#include "sysemu/dma.h"
+#include "hw/irq.h"
+#include "hw/qdev-properties.h"
+#include "hw/sd/nutshell_sdhost.h"
+#include "migration/vmstate.h"
+#include "trace.h"
+
+#define TYPE_NUTSHELL_SDHOST_BUS "nutshell-sdhost-bus"
+/* This is reusing the SDBus typedef from SD_BUS */
+DECLARE_INSTANCE_CHECKER(SDBus, NUTSHELL_SDHOST_BUS,
+                         TYPE_NUTSHELL_SDHOST_BUS)
+
+/* SD host registers */
+#define SDCMD  0x00 /* Command to SD card              - 16 R/W */
+#define SDARG  0x04 /* Argument to SD card             - 32 R/W */
+#define SDTOUT 0x08 /* Start value for timeout counter - 32 R/W */
+#define SDCDIV 0x0c /* Start value for clock divider   - 11 R/W */
+#define SDRSP0 0x10 /* SD card rsp (31:0)         - 32 R   */
+#define SDRSP1 0x14 /* SD card rsp (63:32)        - 32 R   */
+#define SDRSP2 0x18 /* SD card rsp (95:64)        - 32 R   */
+#define SDRSP3 0x1c /* SD card rsp (127:96)       - 32 R   */
+#define SDHSTS 0x20 /* SD host status                  - 11 R   */
+#define SDVDD  0x30 /* SD card power control           -  1 R/W */
+#define SDEDM  0x34 /* Emergency Debug Mode            - 13 R/W */
+#define SDHCFG 0x38 /* Host configuration              -  2 R/W */
+#define SDHBCT 0x3c /* Host byte count (debug)         - 32 R/W */
+#define SDDATA 0x40 /* Data to/from SD card            - 32 R/W */
+#define SDHBLC 0x50 /* Host block count (SDIO/SDHC)    -  9 R/W */
+
+#define SDCMD_NEW_FLAG                  0x8000
+#define SDCMD_FAIL_FLAG                 0x4000
+#define SDCMD_BUSYWAIT                  0x800
+#define SDCMD_NO_RESPONSE               0x400
+#define SDCMD_LONG_RESPONSE             0x200
+#define SDCMD_WRITE_CMD                 0x80
+#define SDCMD_READ_CMD                  0x40
+#define SDCMD_CMD_MASK                  0x3f
+
+#define SDHSTS_BUSY_IRPT                0x400
+#define SDHSTS_BLOCK_IRPT               0x200
+#define SDHSTS_SDIO_IRPT                0x100
+#define SDHSTS_CMD_TIME_OUT             0x40
+#define SDHSTS_FIFO_ERROR               0x08
+#define SDHSTS_DATA_FLAG                0x01
+
+#define SDHCFG_BUSY_IRPT_EN     (1 << 10)
+#define SDHCFG_BLOCK_IRPT_EN    (1 << 8)
+#define SDHCFG_DATA_IRPT_EN     (1 << 4)
+
+#define SDEDM_FSM_MASK           0xf
+#define SDEDM_FSM_DATAMODE       0x1
+#define SDEDM_FSM_READDATA       0x2
+#define SDEDM_FSM_WRITEDATA      0x3
+#define SDEDM_FIFO_FILL_SHIFT    4
+#define SDEDM_FIFO_FILL_MASK     0x1f
+
+#define SDDATA_FIFO_WORDS        16
+
+/* DMA engine registers */
+#define DMA_ADDR_LO 0x00 /* Guest physical address (31:0)   - 32 R/W */
+#define DMA_ADDR_HI 0x04 /* Guest physical address (63:32)  - 32 R/W */
+#define DMA_LEN     0x08 /* Transfer length in bytes        - 32 R/W */
+#define DMA_CTRL    0x0c /* Control                         -  3 R/W */
+#define DMA_STATUS  0x10 /* Status, write 1 to clear        -  3 R/W */
+
+#define DMA_CTRL_START          (1 << 0)
+#define DMA_CTRL_TO_CARD        (1 << 1)
+#define DMA_CTRL_IRQ_EN         (1 << 2)
+
+#define DMA_STATUS_BUSY         (1 << 0)
+#define DMA_STATUS_DONE         (1 << 1)
+#define DMA_STATUS_ERROR        (1 << 2)
+
+static void nutshell_sdhost_update_irq(NutshellSDHostState *s)
+{
+    uint32_t irq = s->status &
+        (SDHSTS_BUSY_IRPT | SDHSTS_BLOCK_IRPT | SDHSTS_SDIO_IRPT);
+
+    if (s->dma_ctrl & DMA_CTRL_IRQ_EN) {
+        irq |= s->dma_status & (DMA_STATUS_DONE | DMA_STATUS_ERROR);
+    }
+    trace_nutshell_sdhost_update_irq(irq);
+    qemu_set_irq(s->irq, !!irq);
+}
+
+static void nutshell_sdhost_update_edm(NutshellSDHostState *s)
+{
+    uint32_t fill = MIN(DIV_ROUND_UP(s->datacnt, 4), SDDATA_FIFO_WORDS);
+
+    s->edm &= ~(SDEDM_FSM_MASK |
+                (SDEDM_FIFO_FILL_MASK << SDEDM_FIFO_FILL_SHIFT));
+    s->edm |= fill << SDEDM_FIFO_FILL_SHIFT;
+    if (s->datacnt == 0) {
+        s->edm |= SDEDM_FSM_DATAMODE;
+    } else if (s->cmd & SDCMD_WRITE_CMD) {
+        s->edm |= SDEDM_FSM_WRITEDATA;
+    } else {
+        s->edm |= SDEDM_FSM_READDATA;
+    }
+}
+
+static void nutshell_sdhost_send_command(NutshellSDHostState *s)
+{
+    SDRequest request;
+    uint8_t rsp[16];
+    int rlen;
+
+    request.cmd = s->cmd & SDCMD_CMD_MASK;
+    request.arg = s->cmdarg;
+
+    rlen = sdbus_do_command(&s->sdbus, &request, rsp);
+    if (rlen < 0) {
+        goto error;
+    }
+    if (!(s->cmd & SDCMD_NO_RESPONSE)) {
+        if (rlen == 0 || (rlen == 4 && (s->cmd & SDCMD_LONG_RESPONSE))) {
+            goto error;
+        }
+        if (rlen != 4 && rlen != 16) {
+            goto error;
+        }
+        if (rlen == 4) {
+            s->rsp[0] = ldl_be_p(&rsp[0]);
+            s->rsp[1] = s->rsp[2] = s->rsp[3] = 0;
+        } else {
+            s->rsp[0] = ldl_be_p(&rsp[12]);
+            s->rsp[1] = ldl_be_p(&rsp[8]);
+            s->rsp[2] = ldl_be_p(&rsp[4]);
+            s->rsp[3] = ldl_be_p(&rsp[0]);
+        }
+    }
+    /* Commands complete immediately, raise the busy interrupt now */
+    if ((s->cmd & SDCMD_BUSYWAIT) && (s->config & SDHCFG_BUSY_IRPT_EN)) {
+        s->status |= SDHSTS_BUSY_IRPT;
+    }
+    return;
+
+error:
+    s->cmd |= SDCMD_FAIL_FLAG;
+    s->status |= SDHSTS_CMD_TIME_OUT;
+}
+
+/* Account for @len bytes moved on the data lines by either PIO or DMA */
+static void nutshell_sdhost_data_done(NutshellSDHostState *s, uint32_t len)
+{
+    uint32_t before = s->datacnt;
+
+    s->datacnt -= len;
+    if (s->datacnt) {
+        s->status |= SDHSTS_DATA_FLAG;
+        if (s->config & SDHCFG_DATA_IRPT_EN) {
+            s->status |= SDHSTS_SDIO_IRPT;
+        }
+    } else {
+        s->status &= ~SDHSTS_DATA_FLAG;
+    }
+    /* Block interrupt whenever a block boundary has been crossed */
+    if (s->hbct && before / s->hbct != s->datacnt / s->hbct &&
+        (s->config & SDHCFG_BLOCK_IRPT_EN)) {
+        s->status |= SDHSTS_BLOCK_IRPT;
+    }
+    nutshell_sdhost_update_edm(s);
+}
+
+static uint32_t nutshell_sdhost_data_read(NutshellSDHostState *s)
+{
+    uint8_t buf[4] = { 0 };
+    uint32_t len = MIN(s->datacnt, sizeof(buf));
+
+    if (!(s->cmd & SDCMD_READ_CMD) || len == 0 ||
+        !sdbus_data_ready(&s->sdbus)) {
+        s->status |= SDHSTS_FIFO_ERROR;
+        return 0;
+    }
+    sdbus_read_data(&s->sdbus, buf, len);
+    nutshell_sdhost_data_done(s, len);
+    return ldl_le_p(buf);
+}
+
+static void nutshell_sdhost_data_write(NutshellSDHostState *s, uint32_t value)
+{
+    uint8_t buf[4];
+    uint32_t len = MIN(s->datacnt, sizeof(buf));
+
+    if (!(s->cmd & SDCMD_WRITE_CMD) || len == 0 ||
+        !sdbus_receive_ready(&s->sdbus)) {
+        s->status |= SDHSTS_FIFO_ERROR;
+        return;
+    }
+    stl_le_p(buf, value);
+    sdbus_write_data(&s->sdbus, buf, len);
+    nutshell_sdhost_data_done(s, len);
+}
+
+/*
+ * Run a DMA transfer to completion.  Guest memory is mapped in as few
+ * chunks as possible (a single one for contiguous RAM) and each chunk is
+ * handed to the SD bus in one go, letting the card move whole blocks
+ * between its backing image and guest memory.
+ */
+static void nutshell_sdhost_dma_run(NutshellSDHostState *s)
+{
+    bool to_card = s->dma_ctrl & DMA_CTRL_TO_CARD;
+    DMADirection dir = to_card ? DMA_DIRECTION_TO_DEVICE
+                               : DMA_DIRECTION_FROM_DEVICE;
+    dma_addr_t len = MIN(s->dma_len, s->datacnt);
+    bool ready;
+
+    trace_nutshell_sdhost_dma_start(s->dma_addr, s->dma_len, to_card);
+
+    ready = to_card ? sdbus_receive_ready(&s->sdbus)
+                    : sdbus_data_ready(&s->sdbus);
+    if (!ready || len == 0) {
+        qemu_log_mask(LOG_GUEST_ERROR,
+                      "%s: no data transfer pending on the card\n", __func__);
+        s->dma_status |= DMA_STATUS_ERROR;
+        goto out;
+    }
+
+    while (len) {
+        dma_addr_t plen = len;
+        void *buf;
+
+        buf = dma_memory_map(&s->dma_as, s->dma_addr, &plen, dir,
+                             MEMTXATTRS_UNSPECIFIED);
+        if (!buf) {
+            qemu_log_mask(LOG_GUEST_ERROR,
+                          "%s: cannot map guest address 0x%" PRIx64 "\n",
+                          __func__, s->dma_addr);
+            s->dma_status |= DMA_STATUS_ERROR;
+            break;
+        }
+        if (to_card) {
+            sdbus_write_data(&s->sdbus, buf, plen);
+        } else {
+            sdbus_read_data(&s->sdbus, buf, plen);
+        }
+        dma_memory_unmap(&s->dma_as, buf, plen, dir, plen);
+
+        s->dma_addr += plen;
+        s->dma_len -= plen;
+        len -= plen;
+        nutshell_sdhost_data_done(s, plen);
+    }
+
+out:
+    s->dma_ctrl &= ~DMA_CTRL_START;
+    s->dma_status &= ~DMA_STATUS_BUSY;
+    s->dma_status |= DMA_STATUS_DONE;
+    trace_nutshell_sdhost_dma_done(s->dma_addr, s->dma_len, s->dma_status);
+    nutshell_sdhost_update_irq(s);
+}
+
+static uint64_t nutshell_sdhost_read(void *opaque, hwaddr offset,
+                                     unsigned size)
+{
+    NutshellSDHostState *s = opaque;
+    uint32_t res = 0;
+
+    switch (offset) {
+    case SDCMD:
+        res = s->cmd;
+        break;
+    case SDARG:
+        res = s->cmdarg;
+        break;
+    case SDHSTS:
+        res = s->status;
+        break;
+    case SDRSP0:
+        res = s->rsp[0];
+        break;
+    case SDRSP1:
+        res = s->rsp[1];
+        break;
+    case SDRSP2:
+        res = s->rsp[2];
+        break;
+    case SDRSP3:
+        res = s->rsp[3];
+        break;
+    case SDEDM:
+        res = s->edm;
+        break;
+    case SDVDD:
+        res = s->vdd;
+        break;
+    case SDHCFG:
+        res = s->config;
+        break;
+    case SDDATA:
+        res = nutshell_sdhost_data_read(s);
+        nutshell_sdhost_update_irq(s);
+        break;
+    case SDHBCT:
+        res = s->hbct;
+        break;
+    case SDHBLC:
+        res = s->hblc;
+        break;
+    case SDTOUT:
+    case SDCDIV:
+        break;
+    default:
+        qemu_log_mask(LOG_GUEST_ERROR, "%s: Bad offset %"HWADDR_PRIx"\n",
+                      __func__, offset);
+        break;
+    }
+
+    trace_nutshell_sdhost_read(offset, res, size);
+
+    return res;
+}
+
+static void nutshell_sdhost_write(void *opaque, hwaddr offset,
+                                  uint64_t value, unsigned size)
+{
+    NutshellSDHostState *s = opaque;
+
+    trace_nutshell_sdhost_write(offset, value, size);
+
+    switch (offset) {
+    case SDCMD:
+        s->cmd = value;
+        if (value & SDCMD_NEW_FLAG) {
+            nutshell_sdhost_send_command(s);
+            nutshell_sdhost_update_edm(s);
+            s->cmd &= ~SDCMD_NEW_FLAG;
+        }
+        break;
+    case SDTOUT:
+    case SDCDIV:
+        break;
+    case SDHSTS:
+        s->status &= ~value;
+        break;
+    case SDARG:
+        s->cmdarg = value;
+        break;
+    case SDEDM:
+        if ((value & 0xf) == 0xf) {
+            /* power down */
+            value &= ~0xf;
+        }
+        s->edm = value;
+        break;
+    case SDHCFG:
+        s->config = value;
+        break;
+    case SDVDD:
+        s->vdd = value;
+        break;
+    case SDDATA:
+        nutshell_sdhost_data_write(s, value);
+        break;
+    case SDHBCT:
+        s->hbct = value;
+        break;
+    case SDHBLC:
+        s->hblc = value;
+        s->datacnt = s->hblc * s->hbct;
+        if (s->datacnt) {
+            s->status |= SDHSTS_DATA_FLAG;
+        }
+        nutshell_sdhost_update_edm(s);
+        break;
+    default:
+        qemu_log_mask(LOG_GUEST_ERROR, "%s: Bad offset %"HWADDR_PRIx"\n",
+                      __func__, offset);
+        break;
+    }
+
+    nutshell_sdhost_update_irq(s);
+}
+
+static const MemoryRegionOps nutshell_sdhost_ops = {
+    .read = nutshell_sdhost_read,
+    .write = nutshell_sdhost_write,
+    .endianness = DEVICE_LITTLE_ENDIAN,
+    .valid = {
+        .min_access_size = 4,
+        .max_access_size = 4,
+    },
+};
+
+static uint64_t nutshell_sdhost_dma_read(void *opaque, hwaddr offset,
+                                         unsigned size)
+{
+    NutshellSDHostState *s = opaque;
+    uint32_t res = 0;
+
+    switch (offset) {
+    case DMA_ADDR_LO:
+        res = extract64(s->dma_addr, 0, 32);
+        break;
+    case DMA_ADDR_HI:
+        res = extract64(s->dma_addr, 32, 32);
+        break;
+    case DMA_LEN:
+        res = s->dma_len;
+        break;
+    case DMA_CTRL:
+        res = s->dma_ctrl;
+        break;
+    case DMA_STATUS:
+        res = s->dma_status;
+        break;
+    default:
+        qemu_log_mask(LOG_GUEST_ERROR, "%s: Bad offset %"HWADDR_PRIx"\n",
+                      __func__, offset);
+        break;
+    }
+
+    trace_nutshell_sdhost_dma_read(offset, res, size);
+
+    return res;
+}
+
+static void nutshell_sdhost_dma_write(void *opaque, hwaddr offset,
+                                      uint64_t value, unsigned size)
+{
+    NutshellSDHostState *s = opaque;
+
+    trace_nutshell_sdhost_dma_write(offset, value, size);
+
+    switch (offset) {
+    case DMA_ADDR_LO:
+        s->dma_addr = deposit64(s->dma_addr, 0, 32, value);
+        break;
+    case DMA_ADDR_HI:
+        s->dma_addr = deposit64(s->dma_addr, 32, 32, value);
+        break;
+    case DMA_LEN:
+        s->dma_len = value;
+        break;
+    case DMA_CTRL:
+        s->dma_ctrl = value & (DMA_CTRL_START | DMA_CTRL_TO_CARD |
+                               DMA_CTRL_IRQ_EN);
+        if (s->dma_ctrl & DMA_CTRL_START) {
+            s->dma_status |= DMA_STATUS_BUSY;
+            nutshell_sdhost_dma_run(s);
+        }
+        break;
+    case DMA_STATUS:
+        s->dma_status &= ~(value & (DMA_STATUS_DONE | DMA_STATUS_ERROR));
+        break;
+    default:
+        qemu_log_mask(LOG_GUEST_ERROR, "%s: Bad offset %"HWADDR_PRIx"\n",
+                      __func__, offset);
+        break;
+    }
+
+    nutshell_sdhost_update_irq(s);
+}
+
+static const MemoryRegionOps nutshell_sdhost_dma_ops = {
+    .read = nutshell_sdhost_dma_read,
+    .write = nutshell_sdhost_dma_write,
+    .endianness = DEVICE_LITTLE_ENDIAN,
+    .valid = {
+        .min_access_size = 4,
+        .max_access_size = 4,
+    },
+};
+
+static const VMStateDescription vmstate_nutshell_sdhost = {
+    .name = TYPE_NUTSHELL_SDHOST,
+    .version_id = 1,
+    .minimum_version_id = 1,
+    .fields = (const VMStateField[]) {
+        VMSTATE_UINT32(cmd, NutshellSDHostState),
+        VMSTATE_UINT32(cmdarg, NutshellSDHostState),
+        VMSTATE_UINT32(status, NutshellSDHostState),
+        VMSTATE_UINT32_ARRAY(rsp, NutshellSDHostState, 4),
+        VMSTATE_UINT32(config, NutshellSDHostState),
+        VMSTATE_UINT32(edm, NutshellSDHostState),
+        VMSTATE_UINT32(vdd, NutshellSDHostState),
+        VMSTATE_UINT32(hbct, NutshellSDHostState),
+        VMSTATE_UINT32(hblc, NutshellSDHostState),
+        VMSTATE_UINT32(datacnt, NutshellSDHostState),
+        VMSTATE_UINT64(dma_addr, NutshellSDHostState),
+        VMSTATE_UINT32(dma_len, NutshellSDHostState),
+        VMSTATE_UINT32(dma_ctrl, NutshellSDHostState),
+        VMSTATE_UINT32(dma_status, NutshellSDHostState),
+        VMSTATE_END_OF_LIST()
+    }
+};
+
+static Property nutshell_sdhost_properties[] = {
+    DEFINE_PROP_LINK("dma-memory", NutshellSDHostState, dma_mr,
+                     TYPE_MEMORY_REGION, MemoryRegion *),
+    DEFINE_PROP_END_OF_LIST(),
+};
+
+static void nutshell_sdhost_init(Object *obj)
+{
+    NutshellSDHostState *s = NUTSHELL_SDHOST(obj);
+
+    qbus_init(&s->sdbus, sizeof(s->sdbus),
+              TYPE_NUTSHELL_SDHOST_BUS, DEVICE(s), "sd-bus");
+
+    memory_region_init_io(&s->iomem, obj, &nutshell_sdhost_ops, s,
+                          TYPE_NUTSHELL_SDHOST, 4 * KiB);
+    sysbus_init_mmio(SYS_BUS_DEVICE(s), &s->iomem);
+    memory_region_init_io(&s->dma_iomem, obj, &nutshell_sdhost_dma_ops, s,
+                          TYPE_NUTSHELL_SDHOST "-dma", 4 * KiB);
+    sysbus_init_mmio(SYS_BUS_DEVICE(s), &s->dma_iomem);
+    sysbus_init_irq(SYS_BUS_DEVICE(s), &s->irq);
+}
+
+static void nutshell_sdhost_realize(DeviceState *dev, Error **errp)
+{
+    NutshellSDHostState *s = NUTSHELL_SDHOST(dev);
+
+    if (!s->dma_mr) {
+        error_setg(errp, TYPE_NUTSHELL_SDHOST " 'dma-memory' link not set");
+        return;
+    }
+
+    address_space_init(&s->dma_as, s->dma_mr, "nutshell-sdhost-dma");
+}
+
+static void nutshell_sdhost_reset(DeviceState *dev)
+{
+    NutshellSDHostState *s = NUTSHELL_SDHOST(dev);
+
+    s->cmd = 0;
+    s->cmdarg = 0;
+    s->status = 0;
+    memset(s->rsp, 0, sizeof(s->rsp));
+    s->edm = 0x0000c60f;
+    s->config = 0;
+    s->vdd = 0;
+    s->hbct = 0;
+    s->hblc = 0;
+    s->datacnt = 0;
+
+    s->dma_addr = 0;
+    s->dma_len = 0;
+    s->dma_ctrl = 0;
+    s->dma_status = 0;
+}
+
+static void nutshell_sdhost_class_init(ObjectClass *klass, void *data)
+{
+    DeviceClass *dc = DEVICE_CLASS(klass);
+
+    dc->realize = nutshell_sdhost_realize;
+    dc->reset = nutshell_sdhost_reset;
+    dc->vmsd = &vmstate_nutshell_sdhost;
+    device_class_set_props(dc, nutshell_sdhost_properties);
+}
+
+static const TypeInfo nutshell_sdhost_types[] = {
+    {
+        .name           = TYPE_NUTSHELL_SDHOST,
+        .parent         = TYPE_SYS_BUS_DEVICE,
+        .instance_size  = sizeof(NutshellSDHostState),
+        .class_init     = nutshell_sdhost_class_init,
+        .instance_init  = nutshell_sdhost_init,
+    },
+    {
+        .name           = TYPE_NUTSHELL_SDHOST_BUS,
+        .parent         = TYPE_SD_BUS,
+        .instance_size  = sizeof(SDBus),
+    },
+};
+
+DEFINE_TYPES(nutshell_sdhost_types)
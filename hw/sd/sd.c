@@ -2548,6 +2548,136 @@ uint8_t sd_read_byte(SDState *sd)
     return ret;
 }
 
+/*
+ * Transfer whole blocks of a CMD18 READ_MULTIPLE_BLOCK straight from the
+ * backing image into @buf, bypassing the per-byte sd->data staging.
+ * Only block-aligned positions are handled; anything else (partial block,
+ * out-of-range block, error condition) is left to sd_read_byte().
+ * A host I/O error ends the transfer with CARD_ECC_FAILED set in the
+ * card status, so that the guest does not take the buffer as data.
+ *
+ * Return: number of bytes transferred (a multiple of the block length).
+ */
+static size_t sd_read_blocks(SDState *sd, void *buf, size_t length)
+{
+    uint32_t io_len;
+    uint64_t nblk;
+
+    if (!sd->blk || !blk_is_inserted(sd->blk) || !sd->enable) {
+        return 0;
+    }
+    if (sd->state != sd_sendingdata_state || sd->current_cmd != 18 ||
+        sd->data_offset != 0) {
+        return 0;
+    }
+    if (sd->card_status & (ADDRESS_ERROR | WP_VIOLATION)) {
+        return 0;
+    }
+
+    io_len = sd_blk_len(sd);
+    nblk = length / io_len;
+    if (sd->multi_blk_cnt != 0) {
+        nblk = MIN(nblk, sd->multi_blk_cnt);
+    }
+    if (sd->data_start >= sd->size) {
+        return 0;
+    }
+    nblk = MIN(nblk, (sd->size - sd->data_start) / io_len);
+    if (nblk == 0) {
+        return 0;
+    }
+
+    trace_sdcard_read_block(sd->data_start, nblk * io_len);
+    if (blk_pread(sd->blk, sd->data_start + sd_bootpart_offset(sd),
+                  nblk * io_len, buf, 0) < 0) {
+        error_report("sd_read_blocks: read error on host side");
+        sd->card_status |= R_CSR_CARD_ECC_FAILED_MASK;
+        sd->state = sd_transfer_state;
+        return 0;
+    }
+    sd->data_start += nblk * io_len;
+
+    if (sd->multi_blk_cnt != 0) {
+        sd->multi_blk_cnt -= nblk;
+        if (sd->multi_blk_cnt == 0) {
+            /* Stop! */
+            sd->state = sd_transfer_state;
+        }
+    }
+
+    return nblk * io_len;
+}
+
+/*
+ * Counterpart of sd_read_blocks() for CMD25 WRITE_MULTIPLE_BLOCK: commit
+ * whole blocks from @buf to the backing image.  Stops short of the first
+ * block which would fail the range or write-protect checks so that
+ * sd_write_byte() can flag the error exactly as it would byte by byte.
+ * A host I/O error ends the transfer with ERROR set in the card status.
+ *
+ * Return: number of bytes transferred (a multiple of the block length).
+ */
+static size_t sd_write_blocks(SDState *sd, const void *buf, size_t length)
+{
+    uint64_t nblk, i;
+
+    if (!sd->blk || !blk_is_inserted(sd->blk) || !sd->enable) {
+        return 0;
+    }
+    if (sd->state != sd_receivingdata_state || sd->current_cmd != 25 ||
+        sd->data_offset != 0) {
+        return 0;
+    }
+    if (sd->card_status & (ADDRESS_ERROR | WP_VIOLATION)) {
+        return 0;
+    }
+
+    nblk = length / sd->blk_len;
+    if (sd->multi_blk_cnt != 0) {
+        nblk = MIN(nblk, sd->multi_blk_cnt);
+    }
+    if (sd->data_start >= sd->size) {
+        return 0;
+    }
+    nblk = MIN(nblk, (sd->size - sd->data_start) / sd->blk_len);
+    if (sd->size <= SDSC_MAX_CAPACITY) {
+        for (i = 0; i < nblk; i++) {
+            if (sd_wp_addr(sd, sd->data_start + i * sd->blk_len)) {
+                break;
+            }
+        }
+        nblk = i;
+    }
+    if (nblk == 0) {
+        return 0;
+    }
+
+    sd->state = sd_programming_state;
+    trace_sdcard_write_block(sd->data_start, nblk * sd->blk_len);
+    if (blk_pwrite(sd->blk, sd->data_start + sd_bootpart_offset(sd),
+                   nblk * sd->blk_len, buf, 0) < 0) {
+        error_report("sd_write_blocks: write error on host side");
+        sd->card_status |= R_CSR_ERROR_MASK;
+        sd->state = sd_transfer_state;
+        return 0;
+    }
+    sd->blk_written += nblk;
+    sd->data_start += nblk * sd->blk_len;
+    sd->csd[14] |= 0x40;
+
+    /* Bzzzzzzztt .... Operation complete.  */
+    sd->state = sd_receivingdata_state;
+    if (sd->multi_blk_cnt != 0) {
+        sd->multi_blk_cnt -= nblk;
+        if (sd->multi_blk_cnt == 0) {
+            /* Stop! */
+            sd->state = sd_transfer_state;
+        }
+    }
+
+    return nblk * sd->blk_len;
+}
+
 static bool sd_receive_ready(SDState *sd)
 {
     return sd->state == sd_receivingdata_state;
@@ -2829,6 +2959,8 @@ static void sdmmc_common_class_init(ObjectClass *klass, void *data)
     sc->do_command = sd_do_command;
     sc->write_byte = sd_write_byte;
     sc->read_byte = sd_read_byte;
+    sc->read_blocks = sd_read_blocks;
+    sc->write_blocks = sd_write_blocks;
     sc->receive_ready = sd_receive_ready;
     sc->data_ready = sd_data_ready;
     sc->enable = sd_enable;
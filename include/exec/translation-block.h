@@ -89,6 +89,23 @@ struct TranslationBlock {
     uint16_t size;
     uint16_t icount;
 
+    /*
+     * Trace formation (-accel tcg,trace-threshold=N).  If profiled is
+     * set when the TB is translated, the generated code decrements
+     * trace_count on entry and counts the goto_tb exits taken in
+     * exit_count[]; the TB is retranslated as a trace once trace_count
+     * is no longer positive.  The updates are not atomic, so with MTTCG
+     * the counts are only approximate.
+     *
+     * With -accel tcg,tier-threshold=N, tier0 marks a TB translated
+     * without the optimizer.  Its trace_count counts down to the
+     * optimized translation instead, and its exits are not counted.
+     */
+    int32_t trace_count;
+    uint32_t exit_count[2];
+    bool profiled;
+    bool tier0;
+
     struct tb_tc tc;
 
     /*
@@ -119,6 +136,12 @@ struct TranslationBlock {
 #define TB_JMP_OFFSET_INVALID 0xffff /* indicates no jump generated */
     uint16_t jmp_reset_offset[2]; /* offset of original jump target */
     uint16_t jmp_insn_offset[2];  /* offset of direct jump insn */
+    /*
+     * Offset of the entry point used when jumping from another TB.  Code
+     * before it reloads the globals pinned to host registers, which only
+     * the entry from the main loop needs (see tcg_global_pin_i64).
+     */
+    uint16_t chain_offset;
     uintptr_t jmp_target_addr[2]; /* target address */
 
     /*
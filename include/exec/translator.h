@@ -174,6 +174,33 @@ void translator_loop(CPUState *cpu, TranslationBlock *tb, int *max_insns,
  */
 bool translator_use_goto_tb(DisasContextBase *db, vaddr dest);
 
+/**
+ * translator_trace_count_exit
+ * @db: Disassembly context
+ * @n: goto_tb slot
+ *
+ * Emit code counting how often the TB leaves through goto_tb slot @n,
+ * if the TB is profiled for trace formation.  Targets that support
+ * traces call this before each tcg_gen_goto_tb().
+ */
+void translator_trace_count_exit(DisasContextBase *db, int n);
+
+/**
+ * translator_trace_hot_exit
+ * @db: Disassembly context
+ * @pc: start of the guest block ending with the current branch
+ * @end: end of the current branch
+ *
+ * When translating a trace, return the goto_tb slot through which the
+ * profiled TB [@pc, @end) leaves most of the time.  The target may
+ * then continue translating along that path, with a side exit for the
+ * other one.  Return -1 if the branch should end the TB as usual.
+ *
+ * Traces must stay within the first page of the TB and only move
+ * forward, so that the TB still covers [pc_first, pc_next).
+ */
+int translator_trace_hot_exit(DisasContextBase *db, vaddr pc, vaddr end);
+
 /**
  * translator_io_start
  * @db: Disassembly context
@@ -34,6 +34,7 @@
 #include "qom/object.h"
 
 #define UART_FIFO_LENGTH    16      /* 16550A Fifo Length */
+#define UART_TX_BATCH_LENGTH 64     /* bytes buffered for the chardev */
 
 struct SerialState {
     DeviceState parent;
@@ -77,6 +78,18 @@ struct SerialState {
     int poll_msl;
 
     QEMUTimer *modem_status_poll;
+
+    /*
+     * With tx-batch, bytes leaving the tsr are collected here and handed
+     * to the chardev in one write when the buffer fills up, on a newline
+     * or when tx_batch_timer expires.
+     */
+    bool tx_batch;
+    uint8_t tx_batch_buf[UART_TX_BATCH_LENGTH];
+    uint32_t tx_batch_len;
+    uint32_t tx_batch_retry;
+    QEMUTimer *tx_batch_timer;
+
     MemoryRegion io;
 };
 typedef struct SerialState SerialState;
@@ -45,6 +45,17 @@ struct TCGCPUOps {
      */
     void (*restore_state_to_opc)(CPUState *cpu, const TranslationBlock *tb,
                                  const uint64_t *data);
+    /**
+     * @config_crc: Checksum of the CPU configuration
+     *
+     * Return a checksum of the configuration that the translation of
+     * guest code depends on beyond the CPU type, such as the extensions
+     * and specification versions enabled with properties.  The code
+     * translated by an earlier run is only translated again at startup
+     * (-accel tcg,tb-cache=...) for CPUs that implement it, and with an
+     * unchanged checksum.
+     */
+    uint32_t (*config_crc)(CPUState *cpu);
 
     /** @cpu_exec_enter: Callback for cpu_exec preparation */
     void (*cpu_exec_enter)(CPUState *cpu);
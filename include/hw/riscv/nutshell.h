@@ -28,14 +28,20 @@ struct NUTSHELLState {
   /*< public >*/
   // CPUClusterState c_cluster;
   RISCVHartArrayState soc[NUTSHELL_SOCKETS_MAX];
-  DeviceState *plic;
+  DeviceState *plic[NUTSHELL_SOCKETS_MAX];
+  DeviceState *sdhost;
   PFlashCFI01 *flash;
+  int fdt_size;
+  bool virtio_mmio;
+  bool uart_tx_batch;
 };
 
 enum {
   UART0_IRQ = 10,
   UART1_IRQ = 11,
   UART2_IRQ = 12,
+  SD_IRQ = 13,
+  UARTLITE_IRQ = 14,
   RTC_IRQ = 11,
   VIRTIO_IRQ = 1, /* 1 to 8 */
   VIRTIO_COUNT = 8,
@@ -57,7 +63,8 @@ enum {
   NUTSHELL_SRAM,
   NUTSHELL_UART0,
   NUTSHELL_UART1,
-  NUTSHELL_UART2
+  NUTSHELL_UART2,
+  NUTSHELL_VIRTIO
 };
 
 /*
@@ -0,0 +1,49 @@
+/*
+ * NutShell SD Host Controller and DMA engine
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#ifndef NUTSHELL_SDHOST_H
+#define NUTSHELL_SDHOST_H
+
+#include "hw/sysbus.h"
+#include "hw/sd/sd.h"
+#include "qom/object.h"
+
+#define TYPE_NUTSHELL_SDHOST "nutshell-sdhost"
+OBJECT_DECLARE_SIMPLE_TYPE(NutshellSDHostState, NUTSHELL_SDHOST)
+
+struct NutshellSDHostState {
+    SysBusDevice busdev;
+    SDBus sdbus;
+    MemoryRegion iomem;
+    MemoryRegion dma_iomem;
+
+    /* Memory region where DMA transfers are done */
+    MemoryRegion *dma_mr;
+    AddressSpace dma_as;
+
+    /* SD host registers (bcm2835-sdhost compatible layout) */
+    uint32_t cmd;
+    uint32_t cmdarg;
+    uint32_t status;
+    uint32_t rsp[4];
+    uint32_t config;
+    uint32_t edm;
+    uint32_t vdd;
+    uint32_t hbct;
+    uint32_t hblc;
+    uint32_t datacnt;
+
+    /* DMA engine registers */
+    uint64_t dma_addr;
+    uint32_t dma_len;
+    uint32_t dma_ctrl;
+    uint32_t dma_status;
+
+    qemu_irq irq;
+};
+
+#endif
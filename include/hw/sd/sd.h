@@ -122,6 +122,30 @@ struct SDCardClass {
      * Return: byte value read
      */
     uint8_t (*read_byte)(SDState *sd);
+    /**
+     * Read whole blocks from a SD card.
+     * @sd: card
+     * @buf: buffer to read data into
+     * @length: maximum number of bytes to read
+     *
+     * Optional fast path for multiple block transfers, moving data
+     * directly between the backing storage and @buf.
+     *
+     * Return: number of bytes read, which may be less than @length
+     * (including 0) when the card can't service the request in bulk.
+     */
+    size_t (*read_blocks)(SDState *sd, void *buf, size_t length);
+    /**
+     * Write whole blocks to a SD card.
+     * @sd: card
+     * @buf: data to write
+     * @length: maximum number of bytes to write
+     *
+     * Counterpart of @read_blocks.
+     *
+     * Return: number of bytes written, which may be less than @length.
+     */
+    size_t (*write_blocks)(SDState *sd, const void *buf, size_t length);
     bool (*receive_ready)(SDState *sd);
     bool (*data_ready)(SDState *sd);
     void (*set_voltage)(SDState *sd, uint16_t millivolts);
@@ -187,6 +211,7 @@ uint8_t sdbus_read_byte(SDBus *sd);
  * @length: number of bytes to write
  *
  * Write multiple bytes of data on the data lines of a SD bus.
+ * Whole blocks are handed to the card in bulk when it supports it.
  */
 void sdbus_write_data(SDBus *sdbus, const void *buf, size_t length);
 /**
@@ -196,6 +221,7 @@ void sdbus_write_data(SDBus *sdbus, const void *buf, size_t length);
  * @length: number of bytes to read
  *
  * Read multiple bytes of data on the data lines of a SD bus.
+ * Whole blocks are fetched from the card in bulk when it supports it.
  */
 void sdbus_read_data(SDBus *sdbus, void *buf, size_t length);
 bool sdbus_receive_ready(SDBus *sd);
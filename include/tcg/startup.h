@@ -55,4 +55,33 @@ void tcg_register_thread(void);
  */
 void tcg_prologue_init(void);
 
+/**
+ * tcg_set_pinned_limit: Allow guest globals to be pinned to host registers
+ * @max: maximum number of globals that tcg_global_pin_*() will accept
+ *
+ * Pinning is disabled by default.  Must be called before the target
+ * creates its globals.
+ */
+void tcg_set_pinned_limit(unsigned max);
+
+/**
+ * tcg_set_hot_pinning: Pin globals to host registers within hot TBs
+ * @enable: whether to pin them
+ *
+ * When retranslating a TB found hot, the pinnable host registers left
+ * over by tcg_global_pin_*() hold the globals used throughout the TB,
+ * for that TB only.  Disabled by default.
+ */
+void tcg_set_hot_pinning(bool enable);
+
+/**
+ * tcg_set_optimize_cse: Enable more expensive optimizations
+ * @enable: whether to enable them
+ *
+ * Let tcg_optimize() eliminate common subexpressions, and stores to env
+ * that are overwritten before anything may read them.  Disabled by
+ * default.
+ */
+void tcg_set_optimize_cse(bool enable);
+
 #endif
@@ -28,6 +28,24 @@ TCGv_i32 tcg_global_mem_new_i32(TCGv_ptr reg, intptr_t off, const char *name);
 TCGv_i64 tcg_global_mem_new_i64(TCGv_ptr reg, intptr_t off, const char *name);
 TCGv_ptr tcg_global_mem_new_ptr(TCGv_ptr reg, intptr_t off, const char *name);
 
+/**
+ * tcg_global_pin_i32/i64() - keep a global in a host register across TBs
+ * @v: global created with tcg_global_mem_new_*() relative to tcg_env
+ *
+ * Pinned globals are given a callee-saved host register of their own.
+ * The register is reloaded only when entering generated code from the
+ * main loop and after helpers that may write globals; chained TBs and
+ * other helpers find the value already there.  The canonical copy in
+ * memory is still kept up to date, so nothing else needs to know.
+ *
+ * Must be called from the target's translator init hook, before any
+ * code is generated.  Returns false, leaving @v an ordinary global,
+ * if the host has no register left or pinning was not enabled with
+ * tcg_set_pinned_limit().
+ */
+bool tcg_global_pin_i32(TCGv_i32 v);
+bool tcg_global_pin_i64(TCGv_i64 v);
+
 /* Generic ops.  */
 
 void gen_set_label(TCGLabel *l);
@@ -410,6 +410,8 @@ typedef struct TCGTemp {
     unsigned int mem_allocated:1;
     unsigned int temp_allocated:1;
     unsigned int temp_subindex:2;
+    unsigned int pinned:1;
+    TCGReg pin_reg:8;
 
     int64_t val;
     struct TCGTemp *mem_base;
@@ -480,6 +482,8 @@ struct TCGContext {
     int nb_globals;
     int nb_temps;
     int nb_indirects;
+    int nb_pinned;
+    int nb_hot_pinned;            /* pinned for the current TB only */
     int nb_ops;
     TCGType addr_type;            /* TCG_TYPE_I32 or TCG_TYPE_I64 */
 
@@ -488,8 +492,11 @@ struct TCGContext {
     uint8_t tlb_dyn_max_bits;
     uint8_t insn_start_words;
     TCGBar guest_mo;
+    bool no_optimize;             /* skip tcg_optimize() for a quick tier 0 */
+    bool hot;                     /* retranslating a TB found hot */
 
     TCGRegSet reserved_regs;
+    TCGRegSet hot_pin_regs;       /* pinned for the current TB only */
     intptr_t current_frame_offset;
     intptr_t frame_start;
     intptr_t frame_end;
@@ -759,6 +766,8 @@ void tcg_pool_reset(TCGContext *s);
 TranslationBlock *tcg_tb_alloc(TCGContext *s);
 
 void tcg_region_reset_all(void);
+void tcg_region_set_evict(bool evict);
+bool tcg_region_evict(GTraverseFunc invalidate, gpointer user_data);
 
 size_t tcg_code_size(void);
 size_t tcg_code_capacity(void);
@@ -36,6 +36,8 @@
 #include "qemu/cutils.h"
 #include "qemu/error-report.h"
 #include "qemu/help_option.h"
+#include "qemu/keyval.h"
+#include "qapi/qmp/qdict.h"
 #include "qemu/module.h"
 #include "qemu/plugin.h"
 #include "user/guest-base.h"
@@ -71,6 +73,7 @@ char *exec_path;
 char real_exec_path[PATH_MAX];
 
 static bool opt_one_insn_per_tb;
+static const char *opt_accel;
 static const char *argv0;
 static const char *gdbstub;
 static envlist_t *envlist;
@@ -417,6 +420,11 @@ static void handle_arg_one_insn_per_tb(const char *arg)
     opt_one_insn_per_tb = true;
 }
 
+static void handle_arg_accel(const char *arg)
+{
+    opt_accel = arg;
+}
+
 static void handle_arg_strace(const char *arg)
 {
     enable_strace = true;
@@ -506,6 +514,8 @@ static const struct qemu_argument arg_table[] = {
     {"one-insn-per-tb",
                    "QEMU_ONE_INSN_PER_TB",  false, handle_arg_one_insn_per_tb,
      "",           "run with one guest instruction per emulated TB"},
+    {"accel",      "QEMU_ACCEL",       true,  handle_arg_accel,
+     "tcg[,prop=value[,...]]", "set TCG accelerator properties"},
     {"strace",     "QEMU_STRACE",      false, handle_arg_strace,
      "",           "log system calls"},
     {"seed",       "QEMU_RAND_SEED",   true,  handle_arg_seed,
@@ -797,6 +807,20 @@ int main(int argc, char **argv, char **envp)
         accel_init_interfaces(ac);
         object_property_set_bool(OBJECT(accel), "one-insn-per-tb",
                                  opt_one_insn_per_tb, &error_abort);
+        if (opt_accel) {
+            QDict *props = keyval_parse(opt_accel, "accel", NULL,
+                                        &error_fatal);
+            const char *name = qdict_get_try_str(props, "accel");
+
+            if (name && strcmp(name, "tcg")) {
+                error_report("-accel: only tcg is supported");
+                exit(EXIT_FAILURE);
+            }
+            qdict_del(props, "accel");
+            object_set_properties_from_keyval(OBJECT(accel), props, false,
+                                              &error_fatal);
+            qobject_unref(props);
+        }
         ac->init_machine(NULL);
     }
 
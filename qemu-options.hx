@@ -187,6 +187,13 @@ DEF("accel", HAS_ARG, QEMU_OPTION_accel,
     "                one-insn-per-tb=on|off (one guest instruction per TCG translation block)\n"
     "                split-wx=on|off (enable TCG split w^x mapping)\n"
     "                tb-size=n (TCG translation block cache size)\n"
+    "                tb-evict=on|off (evict old TCG translations when the cache is full, default=off)\n"
+    "                tb-cache=file (translate the ROM code used by earlier runs at startup)\n"
+    "                trace-threshold=n (retranslate TCG blocks run n times as traces, default 0=off)\n"
+    "                tier-threshold=n (optimize TCG blocks only once run n times, default 0=off)\n"
+    "                pin-regs=n (keep n hot guest registers in TCG host registers, default 0=off)\n"
+    "                hot-regs=on|off (allocate TCG host registers to hot blocks by usage, default=off)\n"
+    "                cse=on|off (eliminate common subexpressions and dead stores in TCG blocks, default=off)\n"
     "                dirty-ring-size=n (KVM dirty ring GFN count, default 0)\n"
     "                eager-split-size=n (KVM Eager Page Split chunk size, default 0, disabled. ARM only)\n"
     "                notify-vmexit=run|internal-error|disable,notify-window=n (enable notify VM exit and set notify window, x86 only)\n"
@@ -230,6 +237,77 @@ SRST
     ``tb-size=n``
         Controls the size (in MiB) of the TCG translation block cache.
 
+    ``tb-evict=on|off``
+        Controls what happens when the TCG translation block cache is
+        full. By default the whole cache is flushed, and all the code
+        that runs afterwards has to be translated again. With
+        ``tb-evict=on`` the cache is split into more regions, and only
+        the oldest regions (about an eighth of the cache) are evicted
+        at a time. Guests whose code does not fit in ``tb-size`` then
+        keep most of their translations.
+
+    ``tb-cache=file``
+        Saves to ``file`` at exit which code in ROM and flash was
+        translated by TCG, and in which CPU mode. Later runs translate that
+        code when the VM starts, before any vCPU runs, instead of as they
+        execute it. No host code is saved. Code whose bytes changed since
+        is skipped. The cache is only used by the same QEMU version, run
+        with the same CPU configuration. An unusable cache is ignored, with
+        a warning, and rewritten at exit. A cache that was used is never
+        rewritten. Only targets that can check the CPU configuration, such
+        as the enabled extensions, support it (currently RISC-V).
+
+    ``trace-threshold=n``
+        Profiles each TCG translation block. A block that has run ``n``
+        times is translated again as a trace. The trace follows the exits
+        that were taken most often by the blocks after it, and leaves
+        through side exits on the other paths. The optimizer and the
+        register allocator can then work across a whole loop body. Only
+        targets that support traces (currently RISC-V) follow branches.
+        Profiling is disabled with icount. The default of 0 disables
+        tracing.
+
+    ``tier-threshold=n``
+        Translates each new TCG translation block quickly at first,
+        without the optimizer, and translates it again with the
+        optimizer once it has run ``n`` times. Code that runs only a few
+        times, such as during boot or when starting a large program, is
+        then translated at a lower cost, while hot code still gets fully
+        optimized host code. Combined with ``trace-threshold``, the
+        optimized block is the one profiled for traces. Tiering is
+        disabled with icount. The default of 0 disables tiering.
+
+    ``pin-regs=n``
+        Keeps up to ``n`` frequently used guest registers in host
+        registers of their own, so that TCG translation blocks chained
+        to each other do not have to load them again. They are still
+        written back to memory as usual, and reloaded on entry from the
+        main loop and after helpers that may modify them. Which registers
+        are pinned is up to the target (currently RISC-V, which pins sp,
+        a0, ra and a1 in that order); the number is limited by the host
+        (currently x86-64 and AArch64, 4 registers). The default of 0
+        disables pinning.
+
+    ``hot-regs=on|off``
+        When a hot TCG translation block is translated again, as a
+        trace (``trace-threshold``) or with the optimizer
+        (``tier-threshold``), counts how often each guest register is
+        used across the branches and helper calls of the block. The
+        most used ones are loaded into the host registers left over by
+        ``pin-regs`` on entry to the block, and stay there until it
+        exits, instead of being reloaded from memory after each branch
+        and helper call. Has an effect only with one of these
+        thresholds, on hosts that support ``pin-regs``. The default is
+        off.
+
+    ``cse=on|off``
+        Lets the TCG optimizer reuse the result of an operation already
+        computed earlier in the block from the same inputs, and drop the
+        stores to CPU state that are overwritten before anything can read
+        them, such as a program counter or flags updated by each guest
+        instruction. This makes translation slower, and mostly pays off
+        for code that runs for a long time. The default is off.
+
     ``thread=single|multi``
         Controls number of TCG threads. When the TCG is multi-threaded
         there will be one thread per vCPU therefore taking advantage of
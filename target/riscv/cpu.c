@@ -527,6 +527,41 @@ static void rv64_sifive_e_cpu_init(Object *obj)
     cpu->cfg.pmp = true;
 }
 
+/*
+ * Multi-letter extensions of the NutShell core. As with any vendor CPU they
+ * can be switched off from the command line but not on.
+ */
+static const RISCVCPUMultiExtConfig nutshell_cpu_exts[] = {
+    { "zicsr", CPU_CFG_OFFSET(ext_zicsr), true },
+    { "zifencei", CPU_CFG_OFFSET(ext_zifencei), true },
+    { "zicntr", CPU_CFG_OFFSET(ext_zicntr), true },
+    { "zihpm", CPU_CFG_OFFSET(ext_zihpm), false },
+    { NULL }
+};
+
+static void rv64_nutshell_cpu_init(Object *obj)
+{
+    RISCVCPU *cpu = RISCV_CPU(obj);
+    CPURISCVState *env = &cpu->env;
+    const RISCVCPUMultiExtConfig *prop;
+
+    /* RV64IMAC: there is no FPU */
+    riscv_cpu_set_misa_ext(env, RVI | RVM | RVA | RVC | RVS | RVU);
+    env->priv_ver = PRIV_VERSION_1_10_0;
+#ifndef CONFIG_USER_ONLY
+    set_satp_mode_max_supported(cpu, VM_1_10_SV39);
+#endif
+
+    for (prop = nutshell_cpu_exts; prop->name; prop++) {
+        isa_ext_update_enabled(cpu, prop->offset, prop->enabled);
+    }
+
+    /* Only mcycle and minstret, no programmable counters */
+    cpu->cfg.pmu_mask = 0;
+    cpu->cfg.mmu = true;
+    cpu->cfg.pmp = true;
+}
+
 static void rv64_thead_c906_cpu_init(Object *obj)
 {
     CPURISCVState *env = &RISCV_CPU(obj)->env;
@@ -1012,6 +1047,7 @@ static void riscv_cpu_reset_hold(Object *obj, ResetType type)
     }
 
     pmp_unlock_entries(env);
+    riscv_pwc_flush(env);
 #endif
     env->xl = riscv_cpu_mxl(env);
     riscv_cpu_update_mask(env);
@@ -2968,7 +3004,7 @@ static const TypeInfo riscv_cpu_type_infos[] = {
     DEFINE_VENDOR_CPU(TYPE_RISCV_CPU_SIFIVE_E51, MXL_RV64,  rv64_sifive_e_cpu_init),
     DEFINE_VENDOR_CPU(TYPE_RISCV_CPU_SIFIVE_U54, MXL_RV64,  rv64_sifive_u_cpu_init),
     DEFINE_VENDOR_CPU(TYPE_RISCV_CPU_SHAKTI_C,   MXL_RV64,  rv64_sifive_u_cpu_init),
-    DEFINE_VENDOR_CPU(TYPE_RISCV_CPU_NUTSHELL,   MXL_RV64,  rv64_sifive_u_cpu_init),
+    DEFINE_VENDOR_CPU(TYPE_RISCV_CPU_NUTSHELL,   MXL_RV64,  rv64_nutshell_cpu_init),
     DEFINE_VENDOR_CPU(TYPE_RISCV_CPU_THEAD_C906, MXL_RV64,  rv64_thead_c906_cpu_init),
     DEFINE_VENDOR_CPU(TYPE_RISCV_CPU_VEYRON_V1,  MXL_RV64,  rv64_veyron_v1_cpu_init),
 #ifdef CONFIG_TCG
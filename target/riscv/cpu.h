@@ -154,6 +154,17 @@ extern RISCVCPUImpliedExtsRule *riscv_multi_ext_implied_rules[];
 #if !defined(CONFIG_USER_ONLY)
 #include "pmp.h"
 #include "debug.h"
+
+/* Page-walk cache geometry, see get_physical_address() */
+#define RISCV_PWC_LEVELS  4     /* non-leaf levels of Sv57 */
+#define RISCV_PWC_ENTRIES 16    /* per level, direct mapped */
+
+typedef struct RISCVPWCEntry {
+    uint64_t vpn;   /* address bits translated by the cached levels */
+    hwaddr root;    /* root page table of the walk */
+    hwaddr base;    /* page table to continue the walk with */
+    uint32_t tag;   /* translation stage and mode, 0 if invalid */
+} RISCVPWCEntry;
 #endif
 
 #define RV_VLEN_MAX 1024
@@ -399,6 +410,9 @@ struct CPUArchState {
     pmp_table_t pmp_state;
     target_ulong mseccfg;
 
+    /* page-walk cache, indexed by the number of levels it skips - 1 */
+    RISCVPWCEntry pwc[RISCV_PWC_LEVELS][RISCV_PWC_ENTRIES];
+
     /* trigger module */
     target_ulong trigger_cur;
     target_ulong tdata1[RV_MAX_TRIGGERS];
@@ -563,6 +577,7 @@ void riscv_cpu_do_transaction_failed(CPUState *cs, hwaddr physaddr,
                                      int mmu_idx, MemTxAttrs attrs,
                                      MemTxResult response, uintptr_t retaddr);
 hwaddr riscv_cpu_get_phys_page_debug(CPUState *cpu, vaddr addr);
+void riscv_pwc_flush(CPURISCVState *env);
 bool riscv_cpu_exec_interrupt(CPUState *cs, int interrupt_request);
 void riscv_cpu_swap_hypervisor_regs(CPURISCVState *env);
 int riscv_cpu_claim_interrupts(RISCVCPU *cpu, uint64_t interrupts);
@@ -616,6 +631,8 @@ FIELD(TB_FLAGS, ITRIGGER, 22, 1)
 FIELD(TB_FLAGS, VIRT_ENABLED, 23, 1)
 FIELD(TB_FLAGS, PRIV, 24, 2)
 FIELD(TB_FLAGS, AXL, 26, 2)
+/* Direct jumps may be chained across guest pages */
+FIELD(TB_FLAGS, CROSS_PAGE_CHAIN, 28, 1)
 
 #ifdef TARGET_RISCV32
 #define riscv_cpu_mxl(env)  ((void)(env), MXL_RV32)
@@ -760,6 +777,7 @@ RISCVException riscv_csrrw_debug(CPURISCVState *env, int csrno,
                                  target_ulong *ret_value,
                                  target_ulong new_value,
                                  target_ulong write_mask);
+bool riscv_csr_inline_ok(CPURISCVState *env, int csrno, bool write);
 
 static inline void riscv_csr_write(CPURISCVState *env, int csrno,
                                    target_ulong val)
@@ -806,8 +824,20 @@ typedef struct {
     riscv_csr_write128_fn write128;
     /* The default priv spec version should be PRIV_VERSION_1_10_0 (i.e 0) */
     uint32_t min_priv_ver;
+    /* Accesses the translator may do itself, see riscv_csr_inline_ok() */
+    uint8_t inline_flags;
 } riscv_csr_operations;
 
+/* riscv_csr_operations::inline_flags */
+enum {
+    /* Reads may be open-coded; implies CSR_PURE_READ */
+    CSR_INLINE_READ  = 1 << 0,
+    /* Writes only touch state the translator knows how to update */
+    CSR_INLINE_WRITE = 1 << 1,
+    /* Reads have no side effects, so the TB need not end after them */
+    CSR_PURE_READ    = 1 << 2,
+};
+
 /* CSR function table constants */
 enum {
     CSR_TABLE_SIZE = 0x1000
@@ -107,6 +107,12 @@ void cpu_get_tb_cpu_state(CPURISCVState *env, vaddr *pc,
 #ifdef CONFIG_USER_ONLY
     fs = EXT_STATUS_DIRTY;
     vs = EXT_STATUS_DIRTY;
+
+    /*
+     * TBs are keyed by virtual address, and unmapping a page or removing
+     * PROT_EXEC invalidates its TBs along with the jumps into them.
+     */
+    flags = FIELD_DP32(flags, TB_FLAGS, CROSS_PAGE_CHAIN, 1);
 #else
     flags = FIELD_DP32(flags, TB_FLAGS, PRIV, env->priv);
 
@@ -133,6 +139,36 @@ void cpu_get_tb_cpu_state(CPURISCVState *env, vaddr *pc,
     if (cpu->cfg.debug && !icount_enabled()) {
         flags = FIELD_DP32(flags, TB_FLAGS, ITRIGGER, env->itrigger_enabled);
     }
+
+    /*
+     * M-mode fetches are untranslated, so the target of a direct jump
+     * is the same physical code for every hart.  As long as no PMP rule
+     * restricts M-mode either, such jumps may be chained across pages:
+     * code changes are caught by the page invalidation of the target TB,
+     * and anything that could break the assumption (a privilege change,
+     * locking a PMP rule, setting MML/MMWP) ends the TB and clears this
+     * flag, so TBs relying on it are no longer found by the next lookup.
+     */
+    if (env->priv == PRV_M && env->pmp_state.num_m_rules == 0 &&
+        !(env->mseccfg & (MSECCFG_MML | MSECCFG_MMWP))) {
+        flags = FIELD_DP32(flags, TB_FLAGS, CROSS_PAGE_CHAIN, 1);
+    }
+
+    /*
+     * The translator only cares whether the unit is off, dirty, or needs
+     * dirtying by the first write: fold INITIAL into CLEAN so that guests
+     * switching between the two (Linux uses INITIAL for new tasks) share
+     * one set of TBs.  Once a TB has dirtied the state, the lookup for
+     * its successor sees DIRTY, so the jump gets chained to TBs that no
+     * longer emit the mstatus update, and a loop pays for it only once
+     * per context switch.
+     */
+    if (fs == EXT_STATUS_INITIAL) {
+        fs = EXT_STATUS_CLEAN;
+    }
+    if (vs == EXT_STATUS_INITIAL) {
+        vs = EXT_STATUS_CLEAN;
+    }
 #endif
 
     flags = FIELD_DP32(flags, TB_FLAGS, FS, fs);
@@ -777,6 +813,55 @@ static int get_physical_address_pmp(CPURISCVState *env, int *prot, hwaddr addr,
     return TRANSLATE_SUCCESS;
 }
 
+/*
+ * The page-walk cache keeps the non-leaf PTEs of recent walks, so that a
+ * TLB miss only has to read the last levels of the page table. Like the
+ * TLB, it may hold stale entries until the guest executes a fence, so it
+ * is flushed together with the TLB on sfence.vma, hfence.*, writes to
+ * the address translation registers and PMP changes.
+ */
+void riscv_pwc_flush(CPURISCVState *env)
+{
+    memset(env->pwc, 0, sizeof(env->pwc));
+}
+
+/*
+ * Return how many levels of the walk for addr the page-walk cache can
+ * skip, and the page table to continue with in *base.
+ */
+static int riscv_pwc_lookup(CPURISCVState *env, uint32_t tag, hwaddr root,
+                            vaddr addr, int levels, int ptidxbits,
+                            hwaddr *base)
+{
+    int depth;
+
+    for (depth = levels - 1; depth > 0; depth--) {
+        uint64_t vpn = addr >> (PGSHIFT + (levels - depth) * ptidxbits);
+        RISCVPWCEntry *e = &env->pwc[depth - 1][vpn % RISCV_PWC_ENTRIES];
+
+        if (e->tag == tag && e->root == root && e->vpn == vpn) {
+            *base = e->base;
+            return depth;
+        }
+    }
+
+    *base = root;
+    return 0;
+}
+
+static void riscv_pwc_insert(CPURISCVState *env, uint32_t tag, hwaddr root,
+                             vaddr addr, int levels, int ptidxbits,
+                             int depth, hwaddr base)
+{
+    uint64_t vpn = addr >> (PGSHIFT + (levels - depth) * ptidxbits);
+    RISCVPWCEntry *e = &env->pwc[depth - 1][vpn % RISCV_PWC_ENTRIES];
+
+    e->vpn = vpn;
+    e->root = root;
+    e->base = base;
+    e->tag = tag;
+}
+
 /*
  * get_physical_address - get the physical address for this virtual address
  *
@@ -920,7 +1005,15 @@ static int get_physical_address(CPURISCVState *env, hwaddr *physical,
         adue = adue && (env->henvcfg & HENVCFG_ADUE);
     }
 
-    int ptshift = (levels - 1) * ptidxbits;
+    /*
+     * Cached walks are told apart by the stage (HS/VS first stage or
+     * G-stage) and the mode, as the same root address may belong to
+     * different address spaces.
+     */
+    int stage = !first_stage ? 2 : (use_background || env->virt_enabled);
+    uint32_t pwc_tag = (vm << 2) | stage;
+    hwaddr root = base;
+    int ptshift;
     target_ulong pte;
     hwaddr pte_addr;
     int i;
@@ -928,7 +1021,9 @@ static int get_physical_address(CPURISCVState *env, hwaddr *physical,
 #if !TCG_OVERSIZED_GUEST
 restart:
 #endif
-    for (i = 0; i < levels; i++, ptshift -= ptidxbits) {
+    i = riscv_pwc_lookup(env, pwc_tag, root, addr, levels, ptidxbits, &base);
+    ptshift = (levels - 1 - i) * ptidxbits;
+    for (; i < levels; i++, ptshift -= ptidxbits) {
         target_ulong idx;
         if (i == 0) {
             idx = (addr >> (PGSHIFT + ptshift)) &
@@ -1011,6 +1106,10 @@ restart:
             return TRANSLATE_FAIL;
         }
         base = ppn << PGSHIFT;
+        if (i + 1 < levels) {
+            riscv_pwc_insert(env, pwc_tag, root, addr, levels, ptidxbits,
+                             i + 1, base);
+        }
     }
 
     /* No leaf pte at any translation level. */
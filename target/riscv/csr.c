@@ -1528,6 +1528,7 @@ static target_ulong legalize_xatp(CPURISCVState *env, target_ulong old_xatp,
          * performance.  Flushing the TLB on SATP writes with paging
          * enabled avoids leaking those invalid cached mappings.
          */
+        riscv_pwc_flush(env);
         tlb_flush(env_cpu(env));
         return val;
     }
@@ -4733,6 +4734,41 @@ static RISCVException riscv_csrrw_do64(CPURISCVState *env, int csrno,
     return RISCV_EXCP_NONE;
 }
 
+/*
+ * riscv_csr_inline_ok - may the translator access @csrno without a helper?
+ *
+ * riscv_csr_operations::inline_flags has two kinds of read flag.
+ * CSR_INLINE_READ lets the translator open-code the read, subject to
+ * the checks below.  CSR_PURE_READ only says that a read changes
+ * nothing, so the translator may call the helper without ending the TB;
+ * it is for CSRs such as the counters whose predicates look at state
+ * outside the TB flags and can therefore never be accessed inline.
+ *
+ * The CSR must be flagged for inline reads, or writes if @write, and the
+ * access must pass riscv_csrrw_check() now.  Only predicates that look
+ * at the configuration and at state covered by the TB flags (privilege,
+ * mstatus.FS/VS) qualify, so that the result holds for every execution
+ * of the TB.  fs() only does so while FP is enabled: otherwise, as with
+ * Zfinx, it depends on the Smstateen CSRs, which are not in the TB flags.
+ */
+bool riscv_csr_inline_ok(CPURISCVState *env, int csrno, bool write)
+{
+    riscv_csr_predicate_fn predicate = csr_ops[csrno].predicate;
+    int flag = write ? CSR_INLINE_WRITE : CSR_INLINE_READ;
+
+    if (!(csr_ops[csrno].inline_flags & flag)) {
+        return false;
+    }
+    if (predicate != any && predicate != any32 &&
+        predicate != fs && predicate != vs) {
+        return false;
+    }
+    if (predicate == fs && !riscv_cpu_fp_enabled(env)) {
+        return false;
+    }
+    return riscv_csrrw_check(env, csrno, write) == RISCV_EXCP_NONE;
+}
+
 RISCVException riscv_csrr(CPURISCVState *env, int csrno,
                            target_ulong *ret_value)
 {
@@ -4904,29 +4940,45 @@ static RISCVException write_jvt(CPURISCVState *env, int csrno,
  */
 riscv_csr_operations csr_ops[CSR_TABLE_SIZE] = {
     /* User Floating-Point CSRs */
-    [CSR_FFLAGS]   = { "fflags",   fs,     read_fflags,  write_fflags },
-    [CSR_FRM]      = { "frm",      fs,     read_frm,     write_frm    },
-    [CSR_FCSR]     = { "fcsr",     fs,     read_fcsr,    write_fcsr   },
+    [CSR_FFLAGS]   = { "fflags",   fs,     read_fflags,  write_fflags,
+                       .inline_flags = CSR_INLINE_READ | CSR_INLINE_WRITE },
+    [CSR_FRM]      = { "frm",      fs,     read_frm,     write_frm,
+                       .inline_flags = CSR_INLINE_READ | CSR_INLINE_WRITE },
+    [CSR_FCSR]     = { "fcsr",     fs,     read_fcsr,    write_fcsr,
+                       .inline_flags = CSR_INLINE_READ | CSR_INLINE_WRITE },
     /* Vector CSRs */
-    [CSR_VSTART]   = { "vstart",   vs,     read_vstart,  write_vstart },
-    [CSR_VXSAT]    = { "vxsat",    vs,     read_vxsat,   write_vxsat  },
-    [CSR_VXRM]     = { "vxrm",     vs,     read_vxrm,    write_vxrm   },
-    [CSR_VCSR]     = { "vcsr",     vs,     read_vcsr,    write_vcsr   },
-    [CSR_VL]       = { "vl",       vs,     read_vl                    },
-    [CSR_VTYPE]    = { "vtype",    vs,     read_vtype                 },
-    [CSR_VLENB]    = { "vlenb",    vs,     read_vlenb                 },
+    [CSR_VSTART]   = { "vstart",   vs,     read_vstart,  write_vstart,
+                       .inline_flags = CSR_INLINE_READ },
+    [CSR_VXSAT]    = { "vxsat",    vs,     read_vxsat,   write_vxsat,
+                       .inline_flags = CSR_INLINE_READ },
+    [CSR_VXRM]     = { "vxrm",     vs,     read_vxrm,    write_vxrm,
+                       .inline_flags = CSR_INLINE_READ },
+    [CSR_VCSR]     = { "vcsr",     vs,     read_vcsr,    write_vcsr,
+                       .inline_flags = CSR_INLINE_READ },
+    [CSR_VL]       = { "vl",       vs,     read_vl,
+                       .inline_flags = CSR_INLINE_READ },
+    [CSR_VTYPE]    = { "vtype",    vs,     read_vtype,
+                       .inline_flags = CSR_INLINE_READ },
+    [CSR_VLENB]    = { "vlenb",    vs,     read_vlenb,
+                       .inline_flags = CSR_INLINE_READ },
     /* User Timers and Counters */
-    [CSR_CYCLE]    = { "cycle",    ctr,    read_hpmcounter  },
-    [CSR_INSTRET]  = { "instret",  ctr,    read_hpmcounter  },
-    [CSR_CYCLEH]   = { "cycleh",   ctr32,  read_hpmcounterh },
-    [CSR_INSTRETH] = { "instreth", ctr32,  read_hpmcounterh },
+    [CSR_CYCLE]    = { "cycle",    ctr,    read_hpmcounter,
+                       .inline_flags = CSR_PURE_READ },
+    [CSR_INSTRET]  = { "instret",  ctr,    read_hpmcounter,
+                       .inline_flags = CSR_PURE_READ },
+    [CSR_CYCLEH]   = { "cycleh",   ctr32,  read_hpmcounterh,
+                       .inline_flags = CSR_PURE_READ },
+    [CSR_INSTRETH] = { "instreth", ctr32,  read_hpmcounterh,
+                       .inline_flags = CSR_PURE_READ },
 
     /*
      * In privileged mode, the monitor will have to emulate TIME CSRs only if
      * rdtime callback is not provided by machine/platform emulation.
      */
-    [CSR_TIME]  = { "time",  ctr,   read_time  },
-    [CSR_TIMEH] = { "timeh", ctr32, read_timeh },
+    [CSR_TIME]  = { "time",  ctr,   read_time,
+                    .inline_flags = CSR_PURE_READ },
+    [CSR_TIMEH] = { "timeh", ctr32, read_timeh,
+                    .inline_flags = CSR_PURE_READ },
 
     /* Crypto Extension */
     [CSR_SEED] = { "seed", seed, NULL, NULL, rmw_seed },
@@ -4946,10 +4998,14 @@ riscv_csr_operations csr_ops[CSR_TABLE_SIZE] = {
                         write_mhpmcounterh                   },
 
     /* Machine Information Registers */
-    [CSR_MVENDORID] = { "mvendorid", any,   read_mvendorid },
-    [CSR_MARCHID]   = { "marchid",   any,   read_marchid   },
-    [CSR_MIMPID]    = { "mimpid",    any,   read_mimpid    },
-    [CSR_MHARTID]   = { "mhartid",   any,   read_mhartid   },
+    [CSR_MVENDORID] = { "mvendorid", any,   read_mvendorid,
+                        .inline_flags = CSR_INLINE_READ },
+    [CSR_MARCHID]   = { "marchid",   any,   read_marchid,
+                        .inline_flags = CSR_INLINE_READ },
+    [CSR_MIMPID]    = { "mimpid",    any,   read_mimpid,
+                        .inline_flags = CSR_INLINE_READ },
+    [CSR_MHARTID]   = { "mhartid",   any,   read_mhartid,
+                        .inline_flags = CSR_INLINE_READ },
 
     [CSR_MCONFIGPTR]  = { "mconfigptr", any,   read_zero,
                           .min_priv_ver = PRIV_VERSION_1_12_0 },
@@ -17,6 +17,8 @@
  */
 
 #include "qemu/osdep.h"
+#include <float.h>
+#include <math.h>
 #include "cpu.h"
 #include "qemu/host-utils.h"
 #include "exec/exec-all.h"
@@ -118,6 +120,280 @@ void helper_set_rounding_mode_chkfrm(CPURISCVState *env, uint32_t rm)
     set_float_rounding_mode(softrm, &env->fp_status);
 }
 
+/*
+ * Host FPU fast path.
+ *
+ * softfloat only hands an operation to the host once the inexact flag is
+ * already set, as the host does not tell whether it rounded.  Guest code
+ * clears fflags often enough (libm, context switches) that most RISC-V
+ * operations never qualify.  Instead, compute the rounding error next to
+ * the result so that inexact can be raised exactly:
+ *
+ *  - single precision is computed in double precision, where products are
+ *    exact and rounding again to single precision gives the correctly
+ *    rounded result for +, -, * and /;
+ *  - sums use TwoSum and products Dekker's TwoProduct (or one FMA when
+ *    the host has a fast one) for the exact error.
+ *
+ * Only round-to-nearest-even with zero or normal inputs is handled, and
+ * only when the result is normal or an exact zero; anything that could
+ * raise another flag is left to softfloat.  Hosts evaluating in excess
+ * precision (x87) always use softfloat.
+ */
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+#define FAST_FP 1
+#else
+#define FAST_FP 0
+#endif
+
+/* Operand and result bounds within which the error terms are exact. */
+#define FAST_F64_MAX    0x1p995
+#define FAST_F64_MIN    0x1p-968
+
+typedef union {
+    uint32_t s;
+    float h;
+} fast_f32;
+
+typedef union {
+    uint64_t s;
+    double h;
+} fast_f64;
+
+static inline bool fast_fp_ok(CPURISCVState *env)
+{
+    return FAST_FP && get_float_rounding_mode(&env->fp_status) ==
+                      float_round_nearest_even;
+}
+
+/* Exact error of the sum @s = @a + @b. */
+static inline double fast_two_sum_err(double a, double b, double s)
+{
+    double bb = s - a;
+
+    return (a - (s - bb)) + (b - bb);
+}
+
+/* Exact error of the product @p = @a * @b, within FAST_F64_{MIN,MAX}. */
+static inline double fast_two_prod_err(double a, double b, double p)
+{
+#ifdef __FP_FAST_FMA
+    return fma(a, b, -p);
+#else
+    const double split = 0x1p27 + 1;
+    double ta = split * a, ah = ta - (ta - a), al = a - ah;
+    double tb = split * b, bh = tb - (tb - b), bl = b - bh;
+
+    return ((ah * bh - p) + ah * bl + al * bh) + al * bl;
+#endif
+}
+
+/*
+ * Round @d to single precision; @err is the exact error of @d.  Fails if
+ * the result is not normal, or if @d sits halfway between two floats but
+ * the exact value does not, where rounding twice could go the wrong way.
+ */
+static bool fast_f32_round(CPURISCVState *env, double d, double err,
+                           float32 *res)
+{
+    fast_f64 ud = { .h = d };
+    fast_f32 uf = { .h = d };
+
+    if (unlikely(!(fabsf(uf.h) > FLT_MIN))) {
+        /* Only an exact zero is not tiny (NaN ends up here too). */
+        if (uf.h != 0 || d != 0 || err != 0) {
+            return false;
+        }
+    } else if (unlikely(isinf(uf.h))) {
+        return false;
+    } else if (unlikely(err != 0 && extract64(ud.s, 0, 29) == 1 << 28)) {
+        return false;
+    }
+    if (err != 0 || (double)uf.h != d) {
+        float_raise(float_flag_inexact, &env->fp_status);
+    }
+    *res = make_float32(uf.s);
+    return true;
+}
+
+/* Check a double precision result with exact error @err. */
+static bool fast_f64_result(CPURISCVState *env, double d, double err,
+                            float64 *res)
+{
+    fast_f64 ud = { .h = d };
+
+    if (unlikely(!(fabs(d) > DBL_MIN))) {
+        if (d != 0 || err != 0) {
+            return false;
+        }
+    } else if (unlikely(isinf(d))) {
+        return false;
+    }
+    if (err != 0) {
+        float_raise(float_flag_inexact, &env->fp_status);
+    }
+    *res = make_float64(ud.s);
+    return true;
+}
+
+static bool fast_f32_ok(CPURISCVState *env, float32 a, float32 b)
+{
+    return fast_fp_ok(env) &&
+           likely(float32_is_zero_or_normal(a) &&
+                  float32_is_zero_or_normal(b));
+}
+
+static bool fast_f64_ok(CPURISCVState *env, float64 a, float64 b)
+{
+    return fast_fp_ok(env) &&
+           likely(float64_is_zero_or_normal(a) &&
+                  float64_is_zero_or_normal(b));
+}
+
+static float32 fast_f32_addsub(CPURISCVState *env, float32 a, float32 b,
+                               bool sub)
+{
+    fast_f32 ua = { .s = float32_val(a) }, ub = { .s = float32_val(b) };
+    float32 r;
+
+    if (fast_f32_ok(env, a, b)) {
+        double x = ua.h, y = sub ? -ub.h : ub.h;
+        double d = x + y;
+
+        if (fast_f32_round(env, d, fast_two_sum_err(x, y, d), &r)) {
+            return r;
+        }
+    }
+    return sub ? float32_sub(a, b, &env->fp_status)
+               : float32_add(a, b, &env->fp_status);
+}
+
+static float32 fast_f32_mul(CPURISCVState *env, float32 a, float32 b)
+{
+    fast_f32 ua = { .s = float32_val(a) }, ub = { .s = float32_val(b) };
+    float32 r;
+
+    /* The double precision product is exact. */
+    if (fast_f32_ok(env, a, b) &&
+        fast_f32_round(env, (double)ua.h * ub.h, 0, &r)) {
+        return r;
+    }
+    return float32_mul(a, b, &env->fp_status);
+}
+
+static float32 fast_f32_div(CPURISCVState *env, float32 a, float32 b)
+{
+    fast_f32 ua = { .s = float32_val(a) }, ub = { .s = float32_val(b) };
+    float32 r;
+
+    /*
+     * A quotient of floats that is not a float lies further away from
+     * every float than a double ulp, so comparing the rounded result
+     * with the double precision one is enough to detect inexact.
+     */
+    if (fast_f32_ok(env, a, b) && !float32_is_zero(b) &&
+        fast_f32_round(env, (double)ua.h / ub.h, 0, &r)) {
+        return r;
+    }
+    return float32_div(a, b, &env->fp_status);
+}
+
+static float32 fast_f32_muladd(CPURISCVState *env, float32 a, float32 b,
+                               float32 c, int flags)
+{
+    fast_f32 ua = { .s = float32_val(a) }, ub = { .s = float32_val(b) };
+    fast_f32 uc = { .s = float32_val(c) };
+    float32 r;
+
+    /* Any other flag, e.g. float_muladd_negate_result, goes to softfloat */
+    if (!(flags & ~(float_muladd_negate_product | float_muladd_negate_c)) &&
+        fast_f32_ok(env, a, b) && float32_is_zero_or_normal(c)) {
+        double p = (double)ua.h * ub.h;
+        double x = uc.h;
+        double d;
+
+        if (flags & float_muladd_negate_product) {
+            p = -p;
+        }
+        if (flags & float_muladd_negate_c) {
+            x = -x;
+        }
+        d = p + x;
+        if (fast_f32_round(env, d, fast_two_sum_err(p, x, d), &r)) {
+            return r;
+        }
+    }
+    return float32_muladd(a, b, c, flags, &env->fp_status);
+}
+
+static float64 fast_f64_addsub(CPURISCVState *env, float64 a, float64 b,
+                               bool sub)
+{
+    fast_f64 ua = { .s = float64_val(a) }, ub = { .s = float64_val(b) };
+    float64 r;
+
+    if (fast_f64_ok(env, a, b)) {
+        double x = ua.h, y = sub ? -ub.h : ub.h;
+        double d = x + y;
+
+        if (fast_f64_result(env, d, fast_two_sum_err(x, y, d), &r)) {
+            return r;
+        }
+    }
+    return sub ? float64_sub(a, b, &env->fp_status)
+               : float64_add(a, b, &env->fp_status);
+}
+
+static float64 fast_f64_mul(CPURISCVState *env, float64 a, float64 b)
+{
+    fast_f64 ua = { .s = float64_val(a) }, ub = { .s = float64_val(b) };
+    float64 r;
+
+    if (fast_f64_ok(env, a, b)) {
+        double d = ua.h * ub.h;
+
+        if (d == 0) {
+            /* Zero operands; normal ones cannot get here without underflow. */
+            if ((float64_is_zero(a) || float64_is_zero(b)) &&
+                fast_f64_result(env, d, 0, &r)) {
+                return r;
+            }
+        } else if (fabs(ua.h) < FAST_F64_MAX && fabs(ub.h) < FAST_F64_MAX &&
+                   fabs(d) > FAST_F64_MIN &&
+                   fast_f64_result(env, d, fast_two_prod_err(ua.h, ub.h, d),
+                                   &r)) {
+            return r;
+        }
+    }
+    return float64_mul(a, b, &env->fp_status);
+}
+
+static float64 fast_f64_div(CPURISCVState *env, float64 a, float64 b)
+{
+    fast_f64 ua = { .s = float64_val(a) }, ub = { .s = float64_val(b) };
+    float64 r;
+
+    if (fast_f64_ok(env, a, b) && !float64_is_zero(b)) {
+        double d = ua.h / ub.h;
+
+        if (float64_is_zero(a)) {
+            if (fast_f64_result(env, d, 0, &r)) {
+                return r;
+            }
+        } else if (fabs(ua.h) > FAST_F64_MIN && fabs(d) > FAST_F64_MIN &&
+                   fabs(d) < FAST_F64_MAX && fabs(ub.h) < FAST_F64_MAX) {
+            /* The quotient is exact iff the remainder a - d * b is zero. */
+            double p = d * ub.h;
+            double rem = (ua.h - p) - fast_two_prod_err(d, ub.h, p);
+
+            if (fast_f64_result(env, d, rem, &r)) {
+                return r;
+            }
+        }
+    }
+    return float64_div(a, b, &env->fp_status);
+}
+
 static uint64_t do_fmadd_h(CPURISCVState *env, uint64_t rs1, uint64_t rs2,
                            uint64_t rs3, int flags)
 {
@@ -134,8 +410,7 @@ static uint64_t do_fmadd_s(CPURISCVState *env, uint64_t rs1, uint64_t rs2,
     float32 frs1 = check_nanbox_s(env, rs1);
     float32 frs2 = check_nanbox_s(env, rs2);
     float32 frs3 = check_nanbox_s(env, rs3);
-    return nanbox_s(env, float32_muladd(frs1, frs2, frs3, flags,
-                                        &env->fp_status));
+    return nanbox_s(env, fast_f32_muladd(env, frs1, frs2, frs3, flags));
 }
 
 uint64_t helper_fmadd_s(CPURISCVState *env, uint64_t frs1, uint64_t frs2,
@@ -219,28 +494,28 @@ uint64_t helper_fadd_s(CPURISCVState *env, uint64_t rs1, uint64_t rs2)
 {
     float32 frs1 = check_nanbox_s(env, rs1);
     float32 frs2 = check_nanbox_s(env, rs2);
-    return nanbox_s(env, float32_add(frs1, frs2, &env->fp_status));
+    return nanbox_s(env, fast_f32_addsub(env, frs1, frs2, false));
 }
 
 uint64_t helper_fsub_s(CPURISCVState *env, uint64_t rs1, uint64_t rs2)
 {
     float32 frs1 = check_nanbox_s(env, rs1);
     float32 frs2 = check_nanbox_s(env, rs2);
-    return nanbox_s(env, float32_sub(frs1, frs2, &env->fp_status));
+    return nanbox_s(env, fast_f32_addsub(env, frs1, frs2, true));
 }
 
 uint64_t helper_fmul_s(CPURISCVState *env, uint64_t rs1, uint64_t rs2)
 {
     float32 frs1 = check_nanbox_s(env, rs1);
     float32 frs2 = check_nanbox_s(env, rs2);
-    return nanbox_s(env, float32_mul(frs1, frs2, &env->fp_status));
+    return nanbox_s(env, fast_f32_mul(env, frs1, frs2));
 }
 
 uint64_t helper_fdiv_s(CPURISCVState *env, uint64_t rs1, uint64_t rs2)
 {
     float32 frs1 = check_nanbox_s(env, rs1);
     float32 frs2 = check_nanbox_s(env, rs2);
-    return nanbox_s(env, float32_div(frs1, frs2, &env->fp_status));
+    return nanbox_s(env, fast_f32_div(env, frs1, frs2));
 }
 
 uint64_t helper_fmin_s(CPURISCVState *env, uint64_t rs1, uint64_t rs2)
@@ -394,22 +669,22 @@ uint64_t helper_froundnx_s(CPURISCVState *env, uint64_t rs1)
 
 uint64_t helper_fadd_d(CPURISCVState *env, uint64_t frs1, uint64_t frs2)
 {
-    return float64_add(frs1, frs2, &env->fp_status);
+    return fast_f64_addsub(env, frs1, frs2, false);
 }
 
 uint64_t helper_fsub_d(CPURISCVState *env, uint64_t frs1, uint64_t frs2)
 {
-    return float64_sub(frs1, frs2, &env->fp_status);
+    return fast_f64_addsub(env, frs1, frs2, true);
 }
 
 uint64_t helper_fmul_d(CPURISCVState *env, uint64_t frs1, uint64_t frs2)
 {
-    return float64_mul(frs1, frs2, &env->fp_status);
+    return fast_f64_mul(env, frs1, frs2);
 }
 
 uint64_t helper_fdiv_d(CPURISCVState *env, uint64_t frs1, uint64_t frs2)
 {
-    return float64_div(frs1, frs2, &env->fp_status);
+    return fast_f64_div(env, frs1, frs2);
 }
 
 uint64_t helper_fmin_d(CPURISCVState *env, uint64_t frs1, uint64_t frs2)
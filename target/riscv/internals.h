@@ -84,6 +84,19 @@ enum {
     RISCV_FRM_ROD = 8,  /* Round to Odd */
 };
 
+/* Operations of helper_amo_misaligned() */
+enum {
+    RISCV_AMO_SWAP,
+    RISCV_AMO_ADD,
+    RISCV_AMO_XOR,
+    RISCV_AMO_AND,
+    RISCV_AMO_OR,
+    RISCV_AMO_MIN,
+    RISCV_AMO_MAX,
+    RISCV_AMO_MINU,
+    RISCV_AMO_MAXU,
+};
+
 static inline uint64_t nanbox_s(CPURISCVState *env, float32 f)
 {
     /* the value is sign-extended instead of NaN-boxing for zfinx */
@@ -24,6 +24,7 @@
 #include "exec/exec-all.h"
 #include "exec/cpu_ldst.h"
 #include "exec/helper-proto.h"
+#include "qemu/atomic128.h"
 
 /* Exceptions processing helpers */
 G_NORETURN void riscv_raise_exception(CPURISCVState *env,
@@ -257,6 +258,95 @@ void helper_cbo_inval(CPURISCVState *env, target_ulong address)
     /* We don't emulate the cache-hierarchy, so we're done. */
 }
 
+/*
+ * Zama16b makes misaligned AMOs atomic as long as they stay within an
+ * aligned 16-byte block.  The generic atomic helpers only take aligned
+ * addresses and stop all other vCPUs for anything else, so do those with
+ * a compare-and-swap loop on the enclosing aligned doubleword, or
+ * quadword if the host has a 128-bit compare-and-swap.
+ */
+static uint64_t amo_apply(uint32_t op, uint64_t old, uint64_t val, int bits)
+{
+    int64_t sold = sextract64(old, 0, bits);
+    int64_t sval = sextract64(val, 0, bits);
+
+    switch (op) {
+    case RISCV_AMO_SWAP:
+        return val;
+    case RISCV_AMO_ADD:
+        return old + val;
+    case RISCV_AMO_XOR:
+        return old ^ val;
+    case RISCV_AMO_AND:
+        return old & val;
+    case RISCV_AMO_OR:
+        return old | val;
+    case RISCV_AMO_MIN:
+        return sold < sval ? old : val;
+    case RISCV_AMO_MAX:
+        return sold > sval ? old : val;
+    case RISCV_AMO_MINU:
+        return extract64(old, 0, bits) < extract64(val, 0, bits) ? old : val;
+    case RISCV_AMO_MAXU:
+        return extract64(old, 0, bits) > extract64(val, 0, bits) ? old : val;
+    default:
+        g_assert_not_reached();
+    }
+}
+
+target_ulong helper_amo_misaligned(CPURISCVState *env, target_ulong addr,
+                                   target_ulong val, uint32_t op,
+                                   uint32_t oi)
+{
+    MemOp mop = get_memop(oi);
+    int mmu_idx = get_mmuidx(oi);
+    int bits = memop_size(mop) * 8;
+    int shift = (addr & 15) * 8;
+    uintptr_t ra = GETPC();
+    uint64_t old;
+
+    if ((shift & 63) + bits <= 64) {
+        MemOpIdx oi8 = make_memop_idx(MO_LEUQ | MO_ALIGN, mmu_idx);
+        target_ulong base = addr & ~7;
+        uint64_t cmp, cur;
+
+        shift &= 63;
+        /* A no-op exchange first, to take any fault as a store. */
+        cur = cpu_atomic_cmpxchgq_le_mmu(env, base, 0, 0, oi8, ra);
+        do {
+            cmp = cur;
+            old = extract64(cmp, shift, bits);
+            cur = cpu_atomic_cmpxchgq_le_mmu(env, base, cmp,
+                      deposit64(cmp, shift, bits,
+                                amo_apply(op, old, val, bits)), oi8, ra);
+        } while (cur != cmp);
+    } else if (HAVE_CMPXCHG128 && shift + bits <= 128) {
+        MemOpIdx oi16 = make_memop_idx(MO_LE | MO_128 | MO_ALIGN, mmu_idx);
+        target_ulong base = addr & ~15;
+        Int128 mask = int128_lshift(int128_make64(MAKE_64BIT_MASK(0, bits)),
+                                    shift);
+        Int128 cmp, cur, new;
+
+        cur = cpu_atomic_cmpxchgo_le_mmu(env, base, int128_zero(),
+                                         int128_zero(), oi16, ra);
+        do {
+            cmp = cur;
+            old = int128_getlo(int128_urshift(cmp, shift)) &
+                  MAKE_64BIT_MASK(0, bits);
+            new = int128_make64(amo_apply(op, old, val, bits) &
+                                MAKE_64BIT_MASK(0, bits));
+            new = int128_or(int128_and(cmp, int128_not(mask)),
+                            int128_lshift(new, shift));
+            cur = cpu_atomic_cmpxchgo_le_mmu(env, base, cmp, new, oi16, ra);
+        } while (!int128_eq(cur, cmp));
+    } else {
+        /* Crosses a 16-byte boundary, or no 128-bit compare-and-swap. */
+        cpu_loop_exit_atomic(env_cpu(env), ra);
+    }
+
+    return mop & MO_SIGN ? sextract64(old, 0, bits) : extract64(old, 0, bits);
+}
+
 #ifndef CONFIG_USER_ONLY
 
 target_ulong helper_sret(CPURISCVState *env)
@@ -395,13 +485,28 @@ void helper_tlb_flush(CPURISCVState *env)
                (env->priv == PRV_U || get_field(env->hstatus, HSTATUS_VTVM))) {
         riscv_raise_exception(env, RISCV_EXCP_VIRT_INSTRUCTION_FAULT, GETPC());
     } else {
+        riscv_pwc_flush(env);
         tlb_flush(cs);
     }
 }
 
+static void riscv_pwc_flush_work(CPUState *cs, run_on_cpu_data data)
+{
+    riscv_pwc_flush(cpu_env(cs));
+}
+
 void helper_tlb_flush_all(CPURISCVState *env)
 {
     CPUState *cs = env_cpu(env);
+    CPUState *other;
+
+    CPU_FOREACH(other) {
+        if (other == cs) {
+            riscv_pwc_flush(env);
+        } else {
+            async_run_on_cpu(other, riscv_pwc_flush_work, RUN_ON_CPU_NULL);
+        }
+    }
     tlb_flush_all_cpus_synced(cs);
 }
 
@@ -415,6 +520,7 @@ void helper_hyp_tlb_flush(CPURISCVState *env)
 
     if (env->priv == PRV_M ||
         (env->priv == PRV_S && !env->virt_enabled)) {
+        riscv_pwc_flush(env);
         tlb_flush(cs);
         return;
     }
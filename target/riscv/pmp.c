@@ -30,6 +30,7 @@
 static bool pmp_write_cfg(CPURISCVState *env, uint32_t addr_index,
                           uint8_t val);
 static uint8_t pmp_read_cfg(CPURISCVState *env, uint32_t addr_index);
+static void pmp_update_seg_table(CPURISCVState *env);
 
 /*
  * Accessor method to extract address matching type 'a field' from cfg reg
@@ -149,6 +150,7 @@ void pmp_unlock_entries(CPURISCVState *env)
     for (i = 0; i < pmp_num; i++) {
         env->pmp_state.pmp[i].cfg_reg &= ~(PMP_LOCK | PMP_AMATCH);
     }
+    pmp_update_rule_nums(env);
 }
 
 static void pmp_decode_napot(hwaddr a, hwaddr *sa, hwaddr *ea)
@@ -211,6 +213,7 @@ void pmp_update_rule_addr(CPURISCVState *env, uint32_t pmp_index)
 
     env->pmp_state.addr[pmp_index].sa = sa;
     env->pmp_state.addr[pmp_index].ea = ea;
+    pmp_update_seg_table(env);
 }
 
 void pmp_update_rule_nums(CPURISCVState *env)
@@ -218,13 +221,18 @@ void pmp_update_rule_nums(CPURISCVState *env)
     int i;
 
     env->pmp_state.num_rules = 0;
+    env->pmp_state.num_m_rules = 0;
     for (i = 0; i < MAX_RISCV_PMPS; i++) {
         const uint8_t a_field =
             pmp_get_a_field(env->pmp_state.pmp[i].cfg_reg);
         if (PMP_AMATCH_OFF != a_field) {
             env->pmp_state.num_rules++;
+            if (env->pmp_state.pmp[i].cfg_reg & PMP_LOCK) {
+                env->pmp_state.num_m_rules++;
+            }
         }
     }
+    pmp_update_seg_table(env);
 }
 
 static int pmp_is_in_range(CPURISCVState *env, int pmp_index, hwaddr addr)
@@ -241,6 +249,87 @@ static int pmp_is_in_range(CPURISCVState *env, int pmp_index, hwaddr addr)
     return result;
 }
 
+/*
+ * Find the segment containing addr. seg[0] always starts at 0.
+ */
+static int pmp_find_seg(CPURISCVState *env, hwaddr addr)
+{
+    int lo = 0;
+    int hi = env->pmp_state.num_segs - 1;
+
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+
+        if (env->pmp_state.seg[mid].sa <= addr) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+
+    return lo;
+}
+
+static int pmp_addr_cmp(const void *a, const void *b)
+{
+    hwaddr x = *(const hwaddr *)a;
+    hwaddr y = *(const hwaddr *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+/*
+ * Rebuild the segment table from the current rules.
+ *
+ * Every start address and every end address + 1 of an active rule is a
+ * point where the matching rule may change. Between two consecutive
+ * points the highest-priority match is constant, so it is computed once
+ * per point here instead of for every lookup. Neighbours that resolve to
+ * the same rule are merged, so a boundary in the table always means a
+ * change of rule.
+ */
+static void pmp_update_seg_table(CPURISCVState *env)
+{
+    pmp_table_t *t = &env->pmp_state;
+    hwaddr points[2 * MAX_RISCV_PMPS + 1];
+    int num_points = 0;
+    int i, j;
+
+    points[num_points++] = 0;
+    for (i = 0; i < MAX_RISCV_PMPS; i++) {
+        if (pmp_get_a_field(t->pmp[i].cfg_reg) == PMP_AMATCH_OFF) {
+            continue;
+        }
+        points[num_points++] = t->addr[i].sa;
+        if (t->addr[i].ea != (hwaddr)-1) {
+            points[num_points++] = t->addr[i].ea + 1;
+        }
+    }
+    qsort(points, num_points, sizeof(hwaddr), pmp_addr_cmp);
+
+    t->num_segs = 0;
+    for (i = 0; i < num_points; i++) {
+        int rule = -1;
+
+        if (i > 0 && points[i] == points[i - 1]) {
+            continue;
+        }
+        for (j = 0; j < MAX_RISCV_PMPS; j++) {
+            if (pmp_get_a_field(t->pmp[j].cfg_reg) != PMP_AMATCH_OFF &&
+                pmp_is_in_range(env, j, points[i])) {
+                rule = j;
+                break;
+            }
+        }
+        if (t->num_segs && t->seg[t->num_segs - 1].rule == rule) {
+            continue;
+        }
+        t->seg[t->num_segs].sa = points[i];
+        t->seg[t->num_segs].rule = rule;
+        t->num_segs++;
+    }
+}
+
 /*
  * Check if the address has required RWX privs when no PMP entry is matched.
  */
@@ -295,6 +384,105 @@ static bool pmp_hart_has_privs_default(CPURISCVState *env, pmp_priv_t privs,
 }
 
 
+/*
+ * Privileges that rule pmp_index grants to an access from mode.
+ */
+static pmp_priv_t pmp_rule_privs(CPURISCVState *env, int pmp_index,
+                                 target_ulong mode)
+{
+    uint8_t cfg = env->pmp_state.pmp[pmp_index].cfg_reg;
+    pmp_priv_t privs;
+
+    if (!MSECCFG_MML_ISSET(env)) {
+        /*
+         * If mseccfg.MML Bit is not set, do pmp priv check
+         * This will always apply to regular PMP.
+         */
+        privs = PMP_READ | PMP_WRITE | PMP_EXEC;
+        if ((mode != PRV_M) || pmp_is_locked(env, pmp_index)) {
+            privs &= cfg;
+        }
+    } else {
+        /*
+         * Convert the PMP permissions to match the truth table in the
+         * Smepmp spec.
+         */
+        const uint8_t smepmp_operation =
+            ((cfg & PMP_LOCK) >> 4) |
+            ((cfg & PMP_READ) << 2) |
+            (cfg & PMP_WRITE) |
+            ((cfg & PMP_EXEC) >> 2);
+
+        if (mode == PRV_M) {
+            switch (smepmp_operation) {
+            case 0:
+            case 1:
+            case 4:
+            case 5:
+            case 6:
+            case 7:
+            case 8:
+                privs = 0;
+                break;
+            case 2:
+            case 3:
+            case 14:
+                privs = PMP_READ | PMP_WRITE;
+                break;
+            case 9:
+            case 10:
+                privs = PMP_EXEC;
+                break;
+            case 11:
+            case 13:
+                privs = PMP_READ | PMP_EXEC;
+                break;
+            case 12:
+            case 15:
+                privs = PMP_READ;
+                break;
+            default:
+                g_assert_not_reached();
+            }
+        } else {
+            switch (smepmp_operation) {
+            case 0:
+            case 8:
+            case 9:
+            case 12:
+            case 13:
+            case 14:
+                privs = 0;
+                break;
+            case 1:
+            case 10:
+            case 11:
+                privs = PMP_EXEC;
+                break;
+            case 2:
+            case 4:
+            case 15:
+                privs = PMP_READ;
+                break;
+            case 3:
+            case 6:
+                privs = PMP_READ | PMP_WRITE;
+                break;
+            case 5:
+                privs = PMP_READ | PMP_EXEC;
+                break;
+            case 7:
+                privs = PMP_READ | PMP_WRITE | PMP_EXEC;
+                break;
+            default:
+                g_assert_not_reached();
+            }
+        }
+    }
+
+    return privs;
+}
+
 /*
  * Public Interface
  */
@@ -308,10 +496,8 @@ bool pmp_hart_has_privs(CPURISCVState *env, hwaddr addr,
                         target_ulong size, pmp_priv_t privs,
                         pmp_priv_t *allowed_privs, target_ulong mode)
 {
-    int i = 0;
     int pmp_size = 0;
-    hwaddr s = 0;
-    hwaddr e = 0;
+    int s_rule, e_rule;
 
     /* Short cut if no rules */
     if (0 == pmp_get_num_rules(env)) {
@@ -334,130 +520,35 @@ bool pmp_hart_has_privs(CPURISCVState *env, hwaddr addr,
 
     /*
      * 1.10 draft priv spec states there is an implicit order
-     * from low to high
+     * from low to high. The segment table already resolved it, so the
+     * rule that decides an address is the one of its segment.
      */
-    for (i = 0; i < MAX_RISCV_PMPS; i++) {
-        s = pmp_is_in_range(env, i, addr);
-        e = pmp_is_in_range(env, i, addr + pmp_size - 1);
+    s_rule = env->pmp_state.seg[pmp_find_seg(env, addr)].rule;
+    e_rule = env->pmp_state.seg[pmp_find_seg(env, addr + pmp_size - 1)].rule;
 
-        /* partially inside */
-        if ((s + e) == 1) {
-            qemu_log_mask(LOG_GUEST_ERROR,
-                          "pmp violation - access is partially inside\n");
-            *allowed_privs = 0;
-            return false;
-        }
-
-        /* fully inside */
-        const uint8_t a_field =
-            pmp_get_a_field(env->pmp_state.pmp[i].cfg_reg);
-
-        /*
-         * Convert the PMP permissions to match the truth table in the
-         * Smepmp spec.
-         */
-        const uint8_t smepmp_operation =
-            ((env->pmp_state.pmp[i].cfg_reg & PMP_LOCK) >> 4) |
-            ((env->pmp_state.pmp[i].cfg_reg & PMP_READ) << 2) |
-            (env->pmp_state.pmp[i].cfg_reg & PMP_WRITE) |
-            ((env->pmp_state.pmp[i].cfg_reg & PMP_EXEC) >> 2);
-
-        if (((s + e) == 2) && (PMP_AMATCH_OFF != a_field)) {
-            /*
-             * If the PMP entry is not off and the address is in range,
-             * do the priv check
-             */
-            if (!MSECCFG_MML_ISSET(env)) {
-                /*
-                 * If mseccfg.MML Bit is not set, do pmp priv check
-                 * This will always apply to regular PMP.
-                 */
-                *allowed_privs = PMP_READ | PMP_WRITE | PMP_EXEC;
-                if ((mode != PRV_M) || pmp_is_locked(env, i)) {
-                    *allowed_privs &= env->pmp_state.pmp[i].cfg_reg;
-                }
-            } else {
-                /*
-                 * If mseccfg.MML Bit set, do the enhanced pmp priv check
-                 */
-                if (mode == PRV_M) {
-                    switch (smepmp_operation) {
-                    case 0:
-                    case 1:
-                    case 4:
-                    case 5:
-                    case 6:
-                    case 7:
-                    case 8:
-                        *allowed_privs = 0;
-                        break;
-                    case 2:
-                    case 3:
-                    case 14:
-                        *allowed_privs = PMP_READ | PMP_WRITE;
-                        break;
-                    case 9:
-                    case 10:
-                        *allowed_privs = PMP_EXEC;
-                        break;
-                    case 11:
-                    case 13:
-                        *allowed_privs = PMP_READ | PMP_EXEC;
-                        break;
-                    case 12:
-                    case 15:
-                        *allowed_privs = PMP_READ;
-                        break;
-                    default:
-                        g_assert_not_reached();
-                    }
-                } else {
-                    switch (smepmp_operation) {
-                    case 0:
-                    case 8:
-                    case 9:
-                    case 12:
-                    case 13:
-                    case 14:
-                        *allowed_privs = 0;
-                        break;
-                    case 1:
-                    case 10:
-                    case 11:
-                        *allowed_privs = PMP_EXEC;
-                        break;
-                    case 2:
-                    case 4:
-                    case 15:
-                        *allowed_privs = PMP_READ;
-                        break;
-                    case 3:
-                    case 6:
-                        *allowed_privs = PMP_READ | PMP_WRITE;
-                        break;
-                    case 5:
-                        *allowed_privs = PMP_READ | PMP_EXEC;
-                        break;
-                    case 7:
-                        *allowed_privs = PMP_READ | PMP_WRITE | PMP_EXEC;
-                        break;
-                    default:
-                        g_assert_not_reached();
-                    }
-                }
-            }
+    /*
+     * If the two ends are decided by different rules, the one with the
+     * higher priority matches one end but not the other.
+     */
+    if (s_rule != e_rule) {
+        qemu_log_mask(LOG_GUEST_ERROR,
+                      "pmp violation - access is partially inside\n");
+        *allowed_privs = 0;
+        return false;
+    }
 
-            /*
-             * If matching address range was found, the protection bits
-             * defined with PMP must be used. We shouldn't fallback on
-             * finding default privileges.
-             */
-            return (privs & *allowed_privs) == privs;
-        }
+    if (s_rule < 0) {
+        /* No rule matched */
+        return pmp_hart_has_privs_default(env, privs, allowed_privs, mode);
     }
 
-    /* No rule matched */
-    return pmp_hart_has_privs_default(env, privs, allowed_privs, mode);
+    /*
+     * If matching address range was found, the protection bits
+     * defined with PMP must be used. We shouldn't fallback on
+     * finding default privileges.
+     */
+    *allowed_privs = pmp_rule_privs(env, s_rule, mode);
+    return (privs & *allowed_privs) == privs;
 }
 
 /*
@@ -481,6 +572,7 @@ void pmpcfg_csr_write(CPURISCVState *env, uint32_t reg_index,
     /* If PMP permission of any addr has been changed, flush TLB pages. */
     if (modified) {
         pmp_update_rule_nums(env);
+        riscv_pwc_flush(env);
         tlb_flush(env_cpu(env));
     }
 }
@@ -538,6 +630,7 @@ void pmpaddr_csr_write(CPURISCVState *env, uint32_t addr_index,
                 if (is_next_cfg_tor) {
                     pmp_update_rule_addr(env, addr_index + 1);
                 }
+                riscv_pwc_flush(env);
                 tlb_flush(env_cpu(env));
             }
         } else {
@@ -592,6 +685,7 @@ void mseccfg_csr_write(CPURISCVState *env, target_ulong val)
         /* Sticky bits */
         val |= (env->mseccfg & (MSECCFG_MMWP | MSECCFG_MML));
         if ((val ^ env->mseccfg) & (MSECCFG_MMWP | MSECCFG_MML)) {
+            riscv_pwc_flush(env);
             tlb_flush(env_cpu(env));
         }
     } else {
@@ -625,8 +719,6 @@ target_ulong mseccfg_csr_read(CPURISCVState *env)
  */
 target_ulong pmp_get_tlb_size(CPURISCVState *env, hwaddr addr)
 {
-    hwaddr pmp_sa;
-    hwaddr pmp_ea;
     hwaddr tlb_sa = addr & ~(TARGET_PAGE_SIZE - 1);
     hwaddr tlb_ea = tlb_sa + TARGET_PAGE_SIZE - 1;
     int i;
@@ -640,37 +732,18 @@ target_ulong pmp_get_tlb_size(CPURISCVState *env, hwaddr addr)
         return TARGET_PAGE_SIZE;
     }
 
-    for (i = 0; i < MAX_RISCV_PMPS; i++) {
-        if (pmp_get_a_field(env->pmp_state.pmp[i].cfg_reg) == PMP_AMATCH_OFF) {
-            continue;
-        }
-
-        pmp_sa = env->pmp_state.addr[i].sa;
-        pmp_ea = env->pmp_state.addr[i].ea;
-
-        /*
-         * Only the first PMP entry that covers (whole or partial of) the TLB
-         * page really matters:
-         * If it covers the whole TLB page, set the size to TARGET_PAGE_SIZE,
-         * since the following PMP entries have lower priority and will not
-         * affect the permissions of the page.
-         * If it only covers partial of the TLB page, set the size to 1 since
-         * the allowed permissions of the region may be different from other
-         * region of the page.
-         */
-        if (pmp_sa <= tlb_sa && pmp_ea >= tlb_ea) {
-            return TARGET_PAGE_SIZE;
-        } else if ((pmp_sa >= tlb_sa && pmp_sa <= tlb_ea) ||
-                   (pmp_ea >= tlb_sa && pmp_ea <= tlb_ea)) {
-            return 1;
-        }
-    }
-
     /*
-     * If no PMP entry matches the TLB page, the TLB page will also not be
-     * split into regions with different permissions by PMP so we set the size
-     * to TARGET_PAGE_SIZE.
+     * The page can be cached as a whole if it lies in a single segment:
+     * then one rule (or none) decides every byte of it. Segment
+     * boundaries always separate different rules, so one inside the page
+     * means parts of it may have different permissions.
      */
+    i = pmp_find_seg(env, tlb_sa);
+    if (i + 1 < env->pmp_state.num_segs &&
+        env->pmp_state.seg[i + 1].sa <= tlb_ea) {
+        return 1;
+    }
+
     return TARGET_PAGE_SIZE;
 }
 
@@ -57,10 +57,23 @@ typedef struct {
     hwaddr ea;
 } pmp_addr_t;
 
+/*
+ * The active rules flattened into disjoint address ranges, sorted by
+ * address. A segment starts at sa and ends where the next one starts,
+ * and rule is the highest-priority rule matching it, or -1 for none.
+ */
+typedef struct {
+    hwaddr sa;
+    int8_t rule;
+} pmp_seg_t;
+
 typedef struct {
     pmp_entry_t pmp[MAX_RISCV_PMPS];
     pmp_addr_t  addr[MAX_RISCV_PMPS];
     uint32_t num_rules;
+    uint32_t num_m_rules;   /* active rules with the L bit set */
+    pmp_seg_t seg[2 * MAX_RISCV_PMPS + 1];
+    uint32_t num_segs;
 } pmp_table_t;
 
 void pmpcfg_csr_write(CPURISCVState *env, uint32_t reg_index,
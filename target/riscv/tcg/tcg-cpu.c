@@ -29,6 +29,7 @@
 #include "qemu/accel.h"
 #include "qemu/error-report.h"
 #include "qemu/log.h"
+#include "qemu/crc32c.h"
 #include "hw/core/accel-cpu.h"
 #include "hw/core/tcg-cpu-ops.h"
 #include "tcg/tcg.h"
@@ -131,10 +132,37 @@ static void riscv_restore_state_to_opc(CPUState *cs,
     env->bins = data[1];
 }
 
+/*
+ * The extensions, their parameters and the spec versions, all of which
+ * translation depends on.  cfg is part of the zero-allocated CPU object,
+ * so its padding is zero too.
+ */
+static uint32_t riscv_cpu_config_crc(CPUState *cs)
+{
+    RISCVCPU *cpu = RISCV_CPU(cs);
+    CPURISCVState *env = &cpu->env;
+    struct {
+        uint32_t misa_mxl_max;
+        uint32_t misa_ext_mask;
+        uint64_t priv_ver;
+        uint64_t vext_ver;
+    } isa = {
+        .misa_mxl_max = RISCV_CPU_GET_CLASS(cpu)->misa_mxl_max,
+        .misa_ext_mask = env->misa_ext_mask,
+        .priv_ver = env->priv_ver,
+        .vext_ver = env->vext_ver,
+    };
+    uint32_t crc;
+
+    crc = crc32c(0xffffffff, (const uint8_t *)&cpu->cfg, sizeof(cpu->cfg));
+    return crc32c(crc, (const uint8_t *)&isa, sizeof(isa));
+}
+
 static const TCGCPUOps riscv_tcg_ops = {
     .initialize = riscv_translate_init,
     .synchronize_from_tb = riscv_cpu_synchronize_from_tb,
     .restore_state_to_opc = riscv_restore_state_to_opc,
+    .config_crc = riscv_cpu_config_crc,
 
 #ifndef CONFIG_USER_ONLY
     .tlb_fill = riscv_cpu_tlb_fill,
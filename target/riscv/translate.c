@@ -112,6 +112,16 @@ typedef struct DisasContext {
     bool ztso;
     /* Use icount trigger for native debug */
     bool itrigger;
+    /* Direct jumps may be chained across guest pages */
+    bool cross_page_chain;
+    /* Trace formation: start of the current block, pending side exits */
+    target_ulong trace_block;
+    int trace_nexits;
+    struct {
+        TCGLabel *label;
+        target_ulong dest;
+        target_ulong pc_save;
+    } trace_exits[8];
     /* FRM is known to contain a valid value. */
     bool frm_valid;
     bool insn_start_updated;
@@ -280,6 +290,20 @@ static void exit_tb(DisasContext *ctx)
     tcg_gen_exit_tb(NULL, 0);
 }
 
+/*
+ * translator_use_goto_tb() only allows chaining within the page of the
+ * TB.  See cpu_get_tb_cpu_state() for when a jump to another page is
+ * safe to chain as well.
+ */
+static bool use_goto_tb(DisasContext *ctx, target_ulong dest)
+{
+    if (translator_use_goto_tb(&ctx->base, dest)) {
+        return true;
+    }
+    return ctx->cross_page_chain &&
+           !(tb_cflags(ctx->base.tb) & CF_NO_GOTO_TB);
+}
+
 static void gen_goto_tb(DisasContext *ctx, int n, target_long diff)
 {
     target_ulong dest = ctx->base.pc_next + diff;
@@ -288,7 +312,8 @@ static void gen_goto_tb(DisasContext *ctx, int n, target_long diff)
       * Under itrigger, instruction executes one by one like singlestep,
       * direct block chain benefits will be small.
       */
-    if (translator_use_goto_tb(&ctx->base, dest) && !ctx->itrigger) {
+    if (use_goto_tb(ctx, dest) && !ctx->itrigger) {
+        translator_trace_count_exit(&ctx->base, n);
         /*
          * For pcrel, the pc must always be up-to-date on entry to
          * the linked TB, so that it can use simple additions for all
@@ -1077,8 +1102,32 @@ static bool gen_unary_per_ol(DisasContext *ctx, arg_r2 *a, DisasExtend ext,
     return gen_unary(ctx, a, ext, f_tl);
 }
 
-static bool gen_amo(DisasContext *ctx, arg_atomic *a,
-                    void(*func)(TCGv, TCGv, TCGv, TCGArg, MemOp),
+typedef void gen_amo_fn(TCGv, TCGv, TCGv, TCGArg, MemOp);
+
+/* The RISCV_AMO_* operation for helper_amo_misaligned() */
+static uint32_t amo_op(gen_amo_fn *func)
+{
+    static gen_amo_fn * const funcs[] = {
+        [RISCV_AMO_SWAP] = tcg_gen_atomic_xchg_tl,
+        [RISCV_AMO_ADD]  = tcg_gen_atomic_fetch_add_tl,
+        [RISCV_AMO_XOR]  = tcg_gen_atomic_fetch_xor_tl,
+        [RISCV_AMO_AND]  = tcg_gen_atomic_fetch_and_tl,
+        [RISCV_AMO_OR]   = tcg_gen_atomic_fetch_or_tl,
+        [RISCV_AMO_MIN]  = tcg_gen_atomic_fetch_smin_tl,
+        [RISCV_AMO_MAX]  = tcg_gen_atomic_fetch_smax_tl,
+        [RISCV_AMO_MINU] = tcg_gen_atomic_fetch_umin_tl,
+        [RISCV_AMO_MAXU] = tcg_gen_atomic_fetch_umax_tl,
+    };
+
+    for (uint32_t i = 0; i < ARRAY_SIZE(funcs); i++) {
+        if (funcs[i] == func) {
+            return i;
+        }
+    }
+    g_assert_not_reached();
+}
+
+static bool gen_amo(DisasContext *ctx, arg_atomic *a, gen_amo_fn *func,
                     MemOp mop)
 {
     TCGv dest = dest_gpr(ctx, a->rd);
@@ -1093,7 +1142,38 @@ static bool gen_amo(DisasContext *ctx, arg_atomic *a,
 
     decode_save_opc(ctx);
     src1 = get_address(ctx, a->rs1, 0);
-    func(dest, src1, src2, ctx->mem_idx, mop);
+
+    if (!(mop & MO_ALIGN) && (tb_cflags(ctx->base.tb) & CF_PARALLEL)) {
+        /*
+         * The generic atomic helpers stop the world for a misaligned
+         * address; leave those to helper_amo_misaligned.  The operands
+         * and the result are copied to TB temps, which stay live across
+         * the labels whatever get_gpr() and dest_gpr() return.
+         */
+        TCGLabel *misaligned = gen_new_label();
+        TCGLabel *done = gen_new_label();
+        TCGv addr = tcg_temp_new();
+        TCGv val = tcg_temp_new();
+        TCGv ret = tcg_temp_new();
+        TCGv t = tcg_temp_new();
+
+        tcg_gen_mov_tl(addr, src1);
+        tcg_gen_mov_tl(val, src2);
+        tcg_gen_andi_tl(t, addr, memop_size(mop) - 1);
+        tcg_gen_brcondi_tl(TCG_COND_NE, t, 0, misaligned);
+        func(ret, addr, val, ctx->mem_idx, mop | MO_ALIGN);
+        tcg_gen_br(done);
+
+        gen_set_label(misaligned);
+        gen_helper_amo_misaligned(ret, tcg_env, addr, val,
+                                  tcg_constant_i32(amo_op(func)),
+                                  tcg_constant_i32(make_memop_idx(mop,
+                                                             ctx->mem_idx)));
+        gen_set_label(done);
+        tcg_gen_mov_tl(dest, ret);
+    } else {
+        func(dest, src1, src2, ctx->mem_idx, mop);
+    }
 
     gen_set_gpr(ctx, a->rd, dest);
     return true;
@@ -1238,6 +1318,9 @@ static void riscv_tr_init_disas_context(DisasContextBase *dcbase, CPUState *cs)
     ctx->pm_base_enabled = FIELD_EX32(tb_flags, TB_FLAGS, PM_BASE_ENABLED);
     ctx->ztso = cpu->cfg.ext_ztso;
     ctx->itrigger = FIELD_EX32(tb_flags, TB_FLAGS, ITRIGGER);
+    ctx->cross_page_chain = FIELD_EX32(tb_flags, TB_FLAGS, CROSS_PAGE_CHAIN);
+    ctx->trace_block = ctx->base.pc_first;
+    ctx->trace_nexits = 0;
     ctx->zero = tcg_constant_tl(0);
     ctx->virt_inst_excp = false;
     ctx->decoders = cpu->decoders;
@@ -1293,6 +1376,7 @@ static void riscv_tr_translate_insn(DisasContextBase *dcbase, CPUState *cpu)
 static void riscv_tr_tb_stop(DisasContextBase *dcbase, CPUState *cpu)
 {
     DisasContext *ctx = container_of(dcbase, DisasContext, base);
+    int i;
 
     switch (ctx->base.is_jmp) {
     case DISAS_TOO_MANY:
@@ -1303,6 +1387,14 @@ static void riscv_tr_tb_stop(DisasContextBase *dcbase, CPUState *cpu)
     default:
         g_assert_not_reached();
     }
+
+    /* Side exits of the trace, see gen_branch_trace() */
+    for (i = 0; i < ctx->trace_nexits; i++) {
+        gen_set_label(ctx->trace_exits[i].label);
+        ctx->pc_save = ctx->trace_exits[i].pc_save;
+        gen_update_pc(ctx, ctx->trace_exits[i].dest - ctx->base.pc_next);
+        lookup_and_goto_ptr(ctx);
+    }
 }
 
 static const TranslatorOps riscv_tr_ops = {
@@ -1323,6 +1415,12 @@ void gen_intermediate_code(CPUState *cs, TranslationBlock *tb, int *max_insns,
 
 void riscv_translate_init(void)
 {
+    /*
+     * The registers that compiled code uses most, hottest first, as seen
+     * when profiling TCG globals over typical workloads.  The host and
+     * -accel tcg,pin-regs decide how many of them are actually pinned.
+     */
+    static const int pinned_gprs[] = { xSP, xA0, xRA, xA1 };
     int i;
 
     /*
@@ -1340,6 +1438,12 @@ void riscv_translate_init(void)
             offsetof(CPURISCVState, gprh[i]), riscv_int_regnamesh[i]);
     }
 
+    for (i = 0; i < ARRAY_SIZE(pinned_gprs); i++) {
+        if (!tcg_global_pin(cpu_gpr[pinned_gprs[i]])) {
+            break;
+        }
+    }
+
     for (i = 0; i < 32; i++) {
         cpu_fpr[i] = tcg_global_mem_new_i64(tcg_env,
             offsetof(CPURISCVState, fpr[i]), riscv_fpr_regnames[i]);
@@ -145,6 +145,15 @@ static inline void vext_set_elem_mask(void *v0, int index,
     ((uint64_t *)v0)[idx] = deposit64(old, pos, 1, value);
 }
 
+/* Set the n mask bits starting at index, which must be a multiple of 64 */
+static inline void vext_set_mask_word(void *v0, int index, int n,
+                                      uint64_t bits)
+{
+    int idx = index / 64;
+    uint64_t old = ((uint64_t *)v0)[idx];
+    ((uint64_t *)v0)[idx] = deposit64(old, 0, n, bits);
+}
+
 /* elements operations for load and store */
 typedef void vext_ldst_elem_fn(CPURISCVState *env, abi_ptr addr,
                                uint32_t idx, void *vd, uintptr_t retaddr);
@@ -175,6 +184,33 @@ GEN_VEXT_ST_ELEM(ste_h, int16_t, H2, stw)
 GEN_VEXT_ST_ELEM(ste_w, int32_t, H4, stl)
 GEN_VEXT_ST_ELEM(ste_d, int64_t, H8, stq)
 
+/* elements operations on host memory, for accesses known to hit RAM */
+typedef void vext_ldst_elem_host_fn(void *vd, uint32_t idx, void *host);
+
+#define GEN_VEXT_LD_ELEM_HOST(NAME, ETYPE, H, LDSUF)       \
+static void NAME(void *vd, uint32_t idx, void *host)       \
+{                                                          \
+    ETYPE *cur = ((ETYPE *)vd + H(idx));                   \
+    *cur = LDSUF##_p(host);                                \
+}
+
+GEN_VEXT_LD_ELEM_HOST(lde_b_host, int8_t,  H1, ldub)
+GEN_VEXT_LD_ELEM_HOST(lde_h_host, int16_t, H2, lduw_le)
+GEN_VEXT_LD_ELEM_HOST(lde_w_host, int32_t, H4, ldl_le)
+GEN_VEXT_LD_ELEM_HOST(lde_d_host, int64_t, H8, ldq_le)
+
+#define GEN_VEXT_ST_ELEM_HOST(NAME, ETYPE, H, STSUF)       \
+static void NAME(void *vd, uint32_t idx, void *host)       \
+{                                                          \
+    ETYPE data = *((ETYPE *)vd + H(idx));                  \
+    STSUF##_p(host, data);                                 \
+}
+
+GEN_VEXT_ST_ELEM_HOST(ste_b_host, int8_t,  H1, stb)
+GEN_VEXT_ST_ELEM_HOST(ste_h_host, int16_t, H2, stw_le)
+GEN_VEXT_ST_ELEM_HOST(ste_w_host, int32_t, H4, stl_le)
+GEN_VEXT_ST_ELEM_HOST(ste_d_host, int64_t, H8, stq_le)
+
 static void vext_set_tail_elems_1s(target_ulong vl, void *vd,
                                    uint32_t desc, uint32_t nf,
                                    uint32_t esz, uint32_t max_elems)
@@ -264,10 +300,91 @@ GEN_VEXT_ST_STRIDE(vsse64_v, int64_t, ste_d)
  * unit-stride: access elements stored contiguously in memory
  */
 
+/*
+ * Fast path for unmasked unit-stride accesses: probe the whole range once
+ * and access the elements from env->vstart to evl directly in host memory.
+ *
+ * Returns false without accessing anything if part of the range is not
+ * plain RAM (MMIO, watchpoints, sub-page TLB entries) or would fault. The
+ * caller then goes element by element, so that exceptions are raised
+ * with vstart pointing at the faulting element.
+ */
+static bool
+vext_ldst_us_host(void *vd, target_ulong base, CPURISCVState *env,
+                  uint32_t nf, uint32_t max_elems, uint32_t log2_esz,
+                  uint32_t evl, vext_ldst_elem_host_fn *ldst_host,
+                  MMUAccessType access_type, uintptr_t ra)
+{
+    uint32_t vstart = env->vstart;
+    target_ulong addr = base + ((vstart * nf) << log2_esz);
+    target_ulong len = ((evl - vstart) * nf) << log2_esz;
+    target_ulong split;
+    int mmu_index = riscv_env_mmu_index(env, false);
+    void *host[2] = { NULL, NULL };
+    uint32_t i, k;
+
+    if (vstart >= evl) {
+        return false;
+    }
+
+    /* Pointer masking must leave the range contiguous */
+    if (adjust_addr(env, addr + len - 1) - adjust_addr(env, addr) != len - 1) {
+        return false;
+    }
+    addr = adjust_addr(env, addr);
+
+    /* The range spans at most two pages, as len <= 8 * vlenb */
+    split = MIN(-(addr | TARGET_PAGE_MASK), len);
+    if (split & ((1 << log2_esz) - 1)) {
+        /* An element crosses the page boundary */
+        return false;
+    }
+    if (probe_access_flags(env, addr, split, access_type, mmu_index,
+                           true, &host[0], ra)) {
+        return false;
+    }
+    if (len > split &&
+        probe_access_flags(env, addr + split, len - split, access_type,
+                           mmu_index, true, &host[1], ra)) {
+        return false;
+    }
+
+#if !HOST_BIG_ENDIAN
+    /* Without segments the register image is the memory image */
+    if (nf == 1) {
+        uint8_t *vreg = (uint8_t *)vd + (vstart << log2_esz);
+
+        if (access_type == MMU_DATA_LOAD) {
+            memcpy(vreg, host[0], split);
+            if (len > split) {
+                memcpy(vreg + split, host[1], len - split);
+            }
+        } else {
+            memcpy(host[0], vreg, split);
+            if (len > split) {
+                memcpy(host[1], vreg + split, len - split);
+            }
+        }
+        return true;
+    }
+#endif
+
+    for (i = vstart; i < evl; i++) {
+        for (k = 0; k < nf; k++) {
+            target_ulong off = ((i - vstart) * nf + k) << log2_esz;
+            void *p = off < split ? host[0] + off : host[1] + (off - split);
+
+            ldst_host(vd, i + k * max_elems, p);
+        }
+    }
+    return true;
+}
+
 /* unmasked unit-stride load and store operation */
 static void
 vext_ldst_us(void *vd, target_ulong base, CPURISCVState *env, uint32_t desc,
-             vext_ldst_elem_fn *ldst_elem, uint32_t log2_esz, uint32_t evl,
+             vext_ldst_elem_fn *ldst_elem, vext_ldst_elem_host_fn *ldst_host,
+             MMUAccessType access_type, uint32_t log2_esz, uint32_t evl,
              uintptr_t ra)
 {
     uint32_t i, k;
@@ -277,13 +394,17 @@ vext_ldst_us(void *vd, target_ulong base, CPURISCVState *env, uint32_t desc,
 
     VSTART_CHECK_EARLY_EXIT(env);
 
-    /* load bytes from guest memory */
-    for (i = env->vstart; i < evl; env->vstart = ++i) {
-        k = 0;
-        while (k < nf) {
-            target_ulong addr = base + ((i * nf + k) << log2_esz);
-            ldst_elem(env, adjust_addr(env, addr), i + k * max_elems, vd, ra);
-            k++;
+    if (!vext_ldst_us_host(vd, base, env, nf, max_elems, log2_esz, evl,
+                           ldst_host, access_type, ra)) {
+        /* load bytes from guest memory */
+        for (i = env->vstart; i < evl; env->vstart = ++i) {
+            k = 0;
+            while (k < nf) {
+                target_ulong addr = base + ((i * nf + k) << log2_esz);
+                ldst_elem(env, adjust_addr(env, addr), i + k * max_elems,
+                          vd, ra);
+                k++;
+            }
         }
     }
     env->vstart = 0;
@@ -308,8 +429,8 @@ void HELPER(NAME##_mask)(void *vd, void *v0, target_ulong base,         \
 void HELPER(NAME)(void *vd, void *v0, target_ulong base,                \
                   CPURISCVState *env, uint32_t desc)                    \
 {                                                                       \
-    vext_ldst_us(vd, base, env, desc, LOAD_FN,                          \
-                 ctzl(sizeof(ETYPE)), env->vl, GETPC());                \
+    vext_ldst_us(vd, base, env, desc, LOAD_FN, LOAD_FN##_host,          \
+                 MMU_DATA_LOAD, ctzl(sizeof(ETYPE)), env->vl, GETPC()); \
 }
 
 GEN_VEXT_LD_US(vle8_v,  int8_t,  lde_b)
@@ -329,8 +450,8 @@ void HELPER(NAME##_mask)(void *vd, void *v0, target_ulong base,          \
 void HELPER(NAME)(void *vd, void *v0, target_ulong base,                 \
                   CPURISCVState *env, uint32_t desc)                     \
 {                                                                        \
-    vext_ldst_us(vd, base, env, desc, STORE_FN,                          \
-                 ctzl(sizeof(ETYPE)), env->vl, GETPC());                 \
+    vext_ldst_us(vd, base, env, desc, STORE_FN, STORE_FN##_host,         \
+                 MMU_DATA_STORE, ctzl(sizeof(ETYPE)), env->vl, GETPC()); \
 }
 
 GEN_VEXT_ST_US(vse8_v,  int8_t,  ste_b)
@@ -346,8 +467,8 @@ void HELPER(vlm_v)(void *vd, void *v0, target_ulong base,
 {
     /* evl = ceil(vl/8) */
     uint8_t evl = (env->vl + 7) >> 3;
-    vext_ldst_us(vd, base, env, desc, lde_b,
-                 0, evl, GETPC());
+    vext_ldst_us(vd, base, env, desc, lde_b, lde_b_host,
+                 MMU_DATA_LOAD, 0, evl, GETPC());
 }
 
 void HELPER(vsm_v)(void *vd, void *v0, target_ulong base,
@@ -355,8 +476,8 @@ void HELPER(vsm_v)(void *vd, void *v0, target_ulong base,
 {
     /* evl = ceil(vl/8) */
     uint8_t evl = (env->vl + 7) >> 3;
-    vext_ldst_us(vd, base, env, desc, ste_b,
-                 0, evl, GETPC());
+    vext_ldst_us(vd, base, env, desc, ste_b, ste_b_host,
+                 MMU_DATA_STORE, 0, evl, GETPC());
 }
 
 /*
@@ -768,6 +889,35 @@ void HELPER(vec_rsubs64)(void *d, void *a, uint64_t b, uint32_t desc)
     }
 }
 
+/* Out-of-line fallbacks of the gvec min/max with a scalar operand */
+#define GEN_VEC_MINMAXS(NAME, ETYPE, DO_OP)                          \
+void HELPER(NAME)(void *d, void *a, uint64_t b, uint32_t desc)       \
+{                                                                    \
+    intptr_t oprsz = simd_oprsz(desc);                               \
+    intptr_t i;                                                      \
+                                                                     \
+    for (i = 0; i < oprsz; i += sizeof(ETYPE)) {                     \
+        *(ETYPE *)(d + i) = DO_OP(*(ETYPE *)(a + i), (ETYPE)b);      \
+    }                                                                \
+}
+
+GEN_VEC_MINMAXS(vec_smins8, int8_t, DO_MIN)
+GEN_VEC_MINMAXS(vec_smins16, int16_t, DO_MIN)
+GEN_VEC_MINMAXS(vec_smins32, int32_t, DO_MIN)
+GEN_VEC_MINMAXS(vec_smins64, int64_t, DO_MIN)
+GEN_VEC_MINMAXS(vec_smaxs8, int8_t, DO_MAX)
+GEN_VEC_MINMAXS(vec_smaxs16, int16_t, DO_MAX)
+GEN_VEC_MINMAXS(vec_smaxs32, int32_t, DO_MAX)
+GEN_VEC_MINMAXS(vec_smaxs64, int64_t, DO_MAX)
+GEN_VEC_MINMAXS(vec_umins8, uint8_t, DO_MIN)
+GEN_VEC_MINMAXS(vec_umins16, uint16_t, DO_MIN)
+GEN_VEC_MINMAXS(vec_umins32, uint32_t, DO_MIN)
+GEN_VEC_MINMAXS(vec_umins64, uint64_t, DO_MIN)
+GEN_VEC_MINMAXS(vec_umaxs8, uint8_t, DO_MAX)
+GEN_VEC_MINMAXS(vec_umaxs16, uint16_t, DO_MAX)
+GEN_VEC_MINMAXS(vec_umaxs32, uint32_t, DO_MAX)
+GEN_VEC_MINMAXS(vec_umaxs64, uint64_t, DO_MAX)
+
 /* Vector Widening Integer Add/Subtract */
 #define WOP_UUU_B uint16_t, uint8_t, uint8_t, uint16_t, uint16_t
 #define WOP_UUU_H uint32_t, uint16_t, uint16_t, uint32_t, uint32_t
@@ -1218,17 +1368,32 @@ void HELPER(NAME)(void *vd, void *v0, void *vs1, void *vs2,   \
                                                               \
     VSTART_CHECK_EARLY_EXIT(env);                             \
                                                               \
-    for (i = env->vstart; i < vl; i++) {                      \
-        ETYPE s1 = *((ETYPE *)vs1 + H(i));                    \
-        ETYPE s2 = *((ETYPE *)vs2 + H(i));                    \
-        if (!vm && !vext_elem_mask(v0, i)) {                  \
-            /* set masked-off elements to 1s */               \
-            if (vma) {                                        \
-                vext_set_elem_mask(vd, i, 1);                 \
+    if (vm && env->vstart == 0) {                             \
+        /* collect 64 results at a time, then store them */   \
+        for (i = 0; i < vl; i += 64) {                        \
+            uint32_t n = MIN(vl - i, 64), j;                  \
+            uint64_t bits = 0;                                \
+            for (j = 0; j < n; j++) {                         \
+                ETYPE s1 = *((ETYPE *)vs1 + H(i + j));        \
+                ETYPE s2 = *((ETYPE *)vs2 + H(i + j));        \
+                bits |= (uint64_t)DO_OP(s2, s1) << j;         \
             }                                                 \
-            continue;                                         \
+            vext_set_mask_word(vd, i, n, bits);               \
+        }                                                     \
+        i = vl;                                               \
+    } else {                                                  \
+        for (i = env->vstart; i < vl; i++) {                  \
+            ETYPE s1 = *((ETYPE *)vs1 + H(i));                \
+            ETYPE s2 = *((ETYPE *)vs2 + H(i));                \
+            if (!vm && !vext_elem_mask(v0, i)) {              \
+                /* set masked-off elements to 1s */           \
+                if (vma) {                                    \
+                    vext_set_elem_mask(vd, i, 1);             \
+                }                                             \
+                continue;                                     \
+            }                                                 \
+            vext_set_elem_mask(vd, i, DO_OP(s2, s1));         \
         }                                                     \
-        vext_set_elem_mask(vd, i, DO_OP(s2, s1));             \
     }                                                         \
     env->vstart = 0;                                          \
     /*
@@ -1285,17 +1450,32 @@ void HELPER(NAME)(void *vd, void *v0, target_ulong s1, void *vs2,   \
                                                                     \
     VSTART_CHECK_EARLY_EXIT(env);                                   \
                                                                     \
-    for (i = env->vstart; i < vl; i++) {                            \
-        ETYPE s2 = *((ETYPE *)vs2 + H(i));                          \
-        if (!vm && !vext_elem_mask(v0, i)) {                        \
-            /* set masked-off elements to 1s */                     \
-            if (vma) {                                              \
-                vext_set_elem_mask(vd, i, 1);                       \
+    if (vm && env->vstart == 0) {                                   \
+        /* collect 64 results at a time, then store them */         \
+        for (i = 0; i < vl; i += 64) {                              \
+            uint32_t n = MIN(vl - i, 64), j;                        \
+            uint64_t bits = 0;                                      \
+            for (j = 0; j < n; j++) {                               \
+                ETYPE s2 = *((ETYPE *)vs2 + H(i + j));              \
+                bits |= (uint64_t)DO_OP(s2, (ETYPE)(target_long)s1) \
+                        << j;                                       \
             }                                                       \
-            continue;                                               \
+            vext_set_mask_word(vd, i, n, bits);                     \
+        }                                                           \
+        i = vl;                                                     \
+    } else {                                                        \
+        for (i = env->vstart; i < vl; i++) {                        \
+            ETYPE s2 = *((ETYPE *)vs2 + H(i));                      \
+            if (!vm && !vext_elem_mask(v0, i)) {                    \
+                /* set masked-off elements to 1s */                 \
+                if (vma) {                                          \
+                    vext_set_elem_mask(vd, i, 1);                   \
+                }                                                   \
+                continue;                                           \
+            }                                                       \
+            vext_set_elem_mask(vd, i,                               \
+                    DO_OP(s2, (ETYPE)(target_long)s1));             \
         }                                                           \
-        vext_set_elem_mask(vd, i,                                   \
-                DO_OP(s2, (ETYPE)(target_long)s1));                 \
     }                                                               \
     env->vstart = 0;                                                \
     /*
@@ -160,14 +160,20 @@ void HELPER(NAME)(void *vd, void *v0, void *vs2,       \
                                                        \
     VSTART_CHECK_EARLY_EXIT(env);                      \
                                                        \
-    for (i = env->vstart; i < vl; i++) {               \
-        if (!vm && !vext_elem_mask(v0, i)) {           \
-            /* set masked-off elements to 1s */        \
-            vext_set_elems_1s(vd, vma, i * ESZ,        \
-                              (i + 1) * ESZ);          \
-            continue;                                  \
+    if (vm) {                                          \
+        for (i = env->vstart; i < vl; i++) {           \
+            do_##NAME(vd, vs2, i);                     \
+        }                                              \
+    } else {                                           \
+        for (i = env->vstart; i < vl; i++) {           \
+            if (!vext_elem_mask(v0, i)) {              \
+                /* set masked-off elements to 1s */    \
+                vext_set_elems_1s(vd, vma, i * ESZ,    \
+                                  (i + 1) * ESZ);      \
+                continue;                              \
+            }                                          \
+            do_##NAME(vd, vs2, i);                     \
         }                                              \
-        do_##NAME(vd, vs2, i);                         \
     }                                                  \
     env->vstart = 0;                                   \
     /* set tail elements to 1s */                      \
@@ -186,9 +192,44 @@ static void do_##NAME(void *vd, void *vs1, void *vs2, int i)    \
     *((TD *)vd + HD(i)) = OP(s2, s1);                           \
 }
 
-void do_vext_vv(void *vd, void *v0, void *vs1, void *vs2,
-                CPURISCVState *env, uint32_t desc,
-                opivv2_fn *fn, uint32_t esz);
+/*
+ * The loop is inlined into every helper, so that the element operation
+ * and size are compile-time constants.  The mask test is hoisted out of
+ * the loop: unmasked instructions (the vm bit set by the translator)
+ * run a branch-free loop that the host compiler can unroll or vectorize.
+ */
+static inline QEMU_ALWAYS_INLINE void
+do_vext_vv(void *vd, void *v0, void *vs1, void *vs2,
+           CPURISCVState *env, uint32_t desc,
+           opivv2_fn *fn, uint32_t esz)
+{
+    uint32_t vm = vext_vm(desc);
+    uint32_t vl = env->vl;
+    uint32_t total_elems = vext_get_total_elems(env, desc, esz);
+    uint32_t vta = vext_vta(desc);
+    uint32_t vma = vext_vma(desc);
+    uint32_t i;
+
+    VSTART_CHECK_EARLY_EXIT(env);
+
+    if (vm) {
+        for (i = env->vstart; i < vl; i++) {
+            fn(vd, vs1, vs2, i);
+        }
+    } else {
+        for (i = env->vstart; i < vl; i++) {
+            if (!vext_elem_mask(v0, i)) {
+                /* set masked-off elements to 1s */
+                vext_set_elems_1s(vd, vma, i * esz, (i + 1) * esz);
+                continue;
+            }
+            fn(vd, vs1, vs2, i);
+        }
+    }
+    env->vstart = 0;
+    /* set tail elements to 1s */
+    vext_set_elems_1s(vd, vta, vl * esz, total_elems * esz);
+}
 
 /* generate the helpers for OPIVV */
 #define GEN_VEXT_VV(NAME, ESZ)                            \
@@ -213,9 +254,39 @@ static void do_##NAME(void *vd, target_long s1, void *vs2, int i)   \
     *((TD *)vd + HD(i)) = OP(s2, (TX1)(T1)s1);                      \
 }
 
-void do_vext_vx(void *vd, void *v0, target_long s1, void *vs2,
-                CPURISCVState *env, uint32_t desc,
-                opivx2_fn fn, uint32_t esz);
+/* Same as do_vext_vv, with a scalar first operand */
+static inline QEMU_ALWAYS_INLINE void
+do_vext_vx(void *vd, void *v0, target_long s1, void *vs2,
+           CPURISCVState *env, uint32_t desc,
+           opivx2_fn fn, uint32_t esz)
+{
+    uint32_t vm = vext_vm(desc);
+    uint32_t vl = env->vl;
+    uint32_t total_elems = vext_get_total_elems(env, desc, esz);
+    uint32_t vta = vext_vta(desc);
+    uint32_t vma = vext_vma(desc);
+    uint32_t i;
+
+    VSTART_CHECK_EARLY_EXIT(env);
+
+    if (vm) {
+        for (i = env->vstart; i < vl; i++) {
+            fn(vd, s1, vs2, i);
+        }
+    } else {
+        for (i = env->vstart; i < vl; i++) {
+            if (!vext_elem_mask(v0, i)) {
+                /* set masked-off elements to 1s */
+                vext_set_elems_1s(vd, vma, i * esz, (i + 1) * esz);
+                continue;
+            }
+            fn(vd, s1, vs2, i);
+        }
+    }
+    env->vstart = 0;
+    /* set tail elements to 1s */
+    vext_set_elems_1s(vd, vta, vl * esz, total_elems * esz);
+}
 
 /* generate the helpers for OPIVX */
 #define GEN_VEXT_VX(NAME, ESZ)                            \
@@ -27,6 +27,7 @@
 #include "qemu/int128.h"
 #include "qemu/interval-tree.h"
 #include "tcg/tcg-op-common.h"
+#include "tcg/startup.h"
 #include "tcg-internal.h"
 
 #define CASE_OP_32_64(x)                        \
@@ -45,8 +46,29 @@ typedef struct MemCopyInfo {
     TCGType type;
 } MemCopyInfo;
 
+/* An env store that nothing has read yet. */
+typedef struct StoreInfo {
+    IntervalTreeNode itree;
+    QSIMPLEQ_ENTRY (StoreInfo) next;
+    TCGOp *op;
+} StoreInfo;
+
+#define CSE_MAX_IARGS  4
+#define CSE_HASH_BITS  6
+
+/* A value computed earlier in the extended basic block. */
+typedef struct CSEInfo {
+    QSIMPLEQ_ENTRY (CSEInfo) next;
+    struct CSEInfo *hash_next;
+    TCGOp *op;
+    TCGTemp *ts;
+    uint32_t ts_version;
+    uint32_t in_version[CSE_MAX_IARGS];
+} CSEInfo;
+
 typedef struct TempOptInfo {
     bool is_const;
+    uint32_t version; /* incremented each time the value changes */
     TCGTemp *prev_copy;
     TCGTemp *next_copy;
     QSIMPLEQ_HEAD(, MemCopyInfo) mem_copy;
@@ -63,6 +85,14 @@ typedef struct OptContext {
     IntervalTreeRoot mem_copy;
     QSIMPLEQ_HEAD(, MemCopyInfo) mem_free;
 
+    /* Common subexpressions and dead env stores, if enabled. */
+    bool cse;
+    IntervalTreeRoot env_st;
+    QSIMPLEQ_HEAD(, StoreInfo) st_free;
+    CSEInfo *cse_hash[1 << CSE_HASH_BITS];
+    QSIMPLEQ_HEAD(, CSEInfo) cse_used;
+    QSIMPLEQ_HEAD(, CSEInfo) cse_free;
+
     /* In flight values from optimization. */
     uint64_t a_mask;  /* mask bit is 0 iff value identical to first input */
     uint64_t z_mask;  /* mask bit is 0 iff value bit is 0 */
@@ -164,6 +194,7 @@ static void init_ts_info(OptContext *ctx, TCGTemp *ts)
     ti = ts->state_ptr;
     if (ti == NULL) {
         ti = tcg_malloc(sizeof(TempOptInfo));
+        ti->version = 0;
         ts->state_ptr = ti;
     }
 
@@ -264,6 +295,7 @@ static void reset_ts(OptContext *ctx, TCGTemp *ts)
     ti->next_copy = ts;
     ti->prev_copy = ts;
     ti->is_const = false;
+    ti->version++;
     ti->z_mask = -1;
     ti->s_mask = 0;
 
@@ -349,6 +381,195 @@ static TCGTemp *find_mem_copy_for(OptContext *ctx, TCGType type, intptr_t s)
     return NULL;
 }
 
+/*
+ * Track the env stores that may be dead: a store is dead if a later
+ * one covers it before anything can read it, i.e. before a load from
+ * env that overlaps it, a use of a global that lives there, a helper
+ * call, a guest memory access that may fault, or the end of the block.
+ * Targets that update a field such as the pc or the flags for each
+ * guest insn then only write it back once, at the end.
+ */
+static void env_st_read(OptContext *ctx, intptr_t s, intptr_t l)
+{
+    IntervalTreeNode *r;
+
+    while ((r = interval_tree_iter_first(&ctx->env_st, s, l)) != NULL) {
+        StoreInfo *si = container_of(r, StoreInfo, itree);
+
+        interval_tree_remove(&si->itree, &ctx->env_st);
+        QSIMPLEQ_INSERT_TAIL(&ctx->st_free, si, next);
+    }
+}
+
+static void env_st_read_all(OptContext *ctx)
+{
+    env_st_read(ctx, 0, -1);
+    tcg_debug_assert(interval_tree_is_empty(&ctx->env_st));
+}
+
+static void env_st_write(OptContext *ctx, TCGOp *op, intptr_t s, intptr_t l)
+{
+    IntervalTreeNode *r;
+    StoreInfo *si;
+
+    /* Remove the pending stores that this one overwrites entirely. */
+    r = interval_tree_iter_first(&ctx->env_st, s, l);
+    while (r) {
+        if (r->start >= s && r->last <= l) {
+            si = container_of(r, StoreInfo, itree);
+            interval_tree_remove(&si->itree, &ctx->env_st);
+            tcg_op_remove(ctx->tcg, si->op);
+            QSIMPLEQ_INSERT_TAIL(&ctx->st_free, si, next);
+            r = interval_tree_iter_first(&ctx->env_st, s, l);
+        } else {
+            r = interval_tree_iter_next(r, s, l);
+        }
+    }
+
+    si = QSIMPLEQ_FIRST(&ctx->st_free);
+    if (si) {
+        QSIMPLEQ_REMOVE_HEAD(&ctx->st_free, next);
+    } else {
+        si = tcg_malloc(sizeof(*si));
+    }
+    memset(si, 0, sizeof(*si));
+    si->itree.start = s;
+    si->itree.last = l;
+    si->op = op;
+    interval_tree_insert(&si->itree, &ctx->env_st);
+}
+
+/* The globals used by @op read their env slot, at the latest when synced. */
+static void env_st_read_globals(OptContext *ctx, TCGOp *op, int nb_args)
+{
+    for (int i = 0; i < nb_args; i++) {
+        TCGTemp *ts = arg_temp(op->args[i]);
+
+        if (ts->kind != TEMP_GLOBAL) {
+            continue;
+        }
+        if (ts->indirect_reg) {
+            /* The base may point anywhere in env. */
+            env_st_read_all(ctx);
+            return;
+        }
+        env_st_read(ctx, ts->mem_offset,
+                    ts->mem_offset + tcg_type_size(ts->type) - 1);
+    }
+}
+
+/*
+ * Value numbering within the extended basic block: an op without side
+ * effects that computes the same thing as an earlier one, from inputs
+ * that have not changed since, becomes a copy of its result.  Inputs
+ * are compared after copy propagation, so copies of the same value
+ * usually compare equal.
+ */
+static bool cse_op_ok(TCGOp *op, const TCGOpDef *def)
+{
+    if (def->nb_oargs != 1 || def->nb_iargs > CSE_MAX_IARGS ||
+        (def->flags & (TCG_OPF_BB_END | TCG_OPF_SIDE_EFFECTS |
+                       TCG_OPF_CALL_CLOBBER | TCG_OPF_NOT_PRESENT))) {
+        return false;
+    }
+
+    switch (op->opc) {
+    CASE_OP_32_64_VEC(mov):
+    /* Loads, which depend on memory. */
+    CASE_OP_32_64(ld8s):
+    CASE_OP_32_64(ld8u):
+    CASE_OP_32_64(ld16s):
+    CASE_OP_32_64(ld16u):
+    case INDEX_op_ld32s_i64:
+    case INDEX_op_ld32u_i64:
+    case INDEX_op_ld_i32:
+    case INDEX_op_ld_i64:
+    case INDEX_op_ld_vec:
+    case INDEX_op_dupm_vec:
+        return false;
+    default:
+        return true;
+    }
+}
+
+static unsigned cse_hash(TCGOp *op, const TCGOpDef *def)
+{
+    int i, n = def->nb_oargs + def->nb_iargs + def->nb_cargs;
+    uint64_t h = op->opc ^ ((uint64_t)op->param1 << 16) ^
+                 ((uint64_t)op->param2 << 24);
+
+    for (i = def->nb_oargs; i < n; i++) {
+        h = (h ^ op->args[i]) * 0x9e3779b97f4a7c15ull;
+    }
+    return h >> (64 - CSE_HASH_BITS);
+}
+
+static bool cse_match(CSEInfo *ci, TCGOp *op, const TCGOpDef *def)
+{
+    TCGOp *prev = ci->op;
+    int i, n = def->nb_oargs + def->nb_iargs + def->nb_cargs;
+
+    if (prev->opc != op->opc || prev->param1 != op->param1 ||
+        prev->param2 != op->param2 ||
+        ts_info(ci->ts)->version != ci->ts_version) {
+        return false;
+    }
+    for (i = def->nb_oargs; i < n; i++) {
+        if (prev->args[i] != op->args[i]) {
+            return false;
+        }
+    }
+    for (i = 0; i < def->nb_iargs; i++) {
+        TCGTemp *ts = arg_temp(op->args[def->nb_oargs + i]);
+        if (ts_info(ts)->version != ci->in_version[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static CSEInfo *cse_find(OptContext *ctx, TCGOp *op, const TCGOpDef *def)
+{
+    CSEInfo *ci;
+
+    for (ci = ctx->cse_hash[cse_hash(op, def)]; ci; ci = ci->hash_next) {
+        if (cse_match(ci, op, def)) {
+            return ci;
+        }
+    }
+    return NULL;
+}
+
+/* Record @op, with the versions its inputs had before it wrote its output. */
+static void cse_record(OptContext *ctx, TCGOp *op, const TCGOpDef *def,
+                       const uint32_t *in_version)
+{
+    unsigned h = cse_hash(op, def);
+    CSEInfo *ci;
+
+    ci = QSIMPLEQ_FIRST(&ctx->cse_free);
+    if (ci) {
+        QSIMPLEQ_REMOVE_HEAD(&ctx->cse_free, next);
+    } else {
+        ci = tcg_malloc(sizeof(*ci));
+    }
+    ci->op = op;
+    ci->ts = arg_temp(op->args[0]);
+    ci->ts_version = ts_info(ci->ts)->version;
+    memcpy(ci->in_version, in_version, sizeof(ci->in_version));
+    ci->hash_next = ctx->cse_hash[h];
+    ctx->cse_hash[h] = ci;
+    QSIMPLEQ_INSERT_TAIL(&ctx->cse_used, ci, next);
+}
+
+static void cse_reset(OptContext *ctx)
+{
+    if (!QSIMPLEQ_EMPTY(&ctx->cse_used)) {
+        QSIMPLEQ_CONCAT(&ctx->cse_free, &ctx->cse_used);
+        memset(ctx->cse_hash, 0, sizeof(ctx->cse_hash));
+    }
+}
+
 static TCGArg arg_new_constant(OptContext *ctx, uint64_t val)
 {
     TCGType type = ctx->type;
@@ -978,6 +1199,7 @@ static void finish_folding(OptContext *ctx, TCGOp *op)
         if (!(def->flags & TCG_OPF_COND_BRANCH)) {
             memset(&ctx->temps_used, 0, sizeof(ctx->temps_used));
             remove_mem_copy_all(ctx);
+            cse_reset(ctx);
         }
         return;
     }
@@ -1530,6 +1752,11 @@ static bool fold_call(OptContext *ctx, TCGOp *op)
         remove_mem_copy_all(ctx);
     }
 
+    /* Any function may look at env, or raise an exception. */
+    if (ctx->cse) {
+        env_st_read_all(ctx);
+    }
+
     /* Reset temp data for outputs. */
     for (i = 0; i < nb_oargs; i++) {
         reset_temp(ctx, op->args[i]);
@@ -2565,34 +2792,56 @@ static bool fold_sub2(OptContext *ctx, TCGOp *op)
     return fold_addsub2(ctx, op, false);
 }
 
+/* A load of [ofs, ofs + @lm1] from env reads the stores pending there. */
+static void fold_tcg_ld_env(OptContext *ctx, TCGOp *op, intptr_t lm1)
+{
+    if (!ctx->cse) {
+        return;
+    }
+    if (op->args[1] != tcgv_ptr_arg(tcg_env)) {
+        env_st_read_all(ctx);
+    } else {
+        env_st_read(ctx, op->args[2], op->args[2] + lm1);
+    }
+}
+
 static bool fold_tcg_ld(OptContext *ctx, TCGOp *op)
 {
+    intptr_t lm1;
+
     /* We can't do any folding with a load, but we can record bits. */
     switch (op->opc) {
     CASE_OP_32_64(ld8s):
         ctx->s_mask = MAKE_64BIT_MASK(8, 56);
+        lm1 = 0;
         break;
     CASE_OP_32_64(ld8u):
         ctx->z_mask = MAKE_64BIT_MASK(0, 8);
         ctx->s_mask = MAKE_64BIT_MASK(9, 55);
+        lm1 = 0;
         break;
     CASE_OP_32_64(ld16s):
         ctx->s_mask = MAKE_64BIT_MASK(16, 48);
+        lm1 = 1;
         break;
     CASE_OP_32_64(ld16u):
         ctx->z_mask = MAKE_64BIT_MASK(0, 16);
         ctx->s_mask = MAKE_64BIT_MASK(17, 47);
+        lm1 = 1;
         break;
     case INDEX_op_ld32s_i64:
         ctx->s_mask = MAKE_64BIT_MASK(32, 32);
+        lm1 = 3;
         break;
     case INDEX_op_ld32u_i64:
         ctx->z_mask = MAKE_64BIT_MASK(0, 32);
         ctx->s_mask = MAKE_64BIT_MASK(33, 31);
+        lm1 = 3;
         break;
     default:
         g_assert_not_reached();
     }
+    fold_tcg_ld_env(ctx, op, lm1);
     return false;
 }
 
@@ -2602,6 +2851,7 @@ static bool fold_tcg_ld_memcopy(OptContext *ctx, TCGOp *op)
     intptr_t ofs;
     TCGType type;
 
+    fold_tcg_ld_env(ctx, op, tcg_type_size(ctx->type) - 1);
     if (op->args[1] != tcgv_ptr_arg(tcg_env)) {
         return false;
     }
@@ -2626,6 +2876,10 @@ static bool fold_tcg_st(OptContext *ctx, TCGOp *op)
 
     if (op->args[1] != tcgv_ptr_arg(tcg_env)) {
         remove_mem_copy_all(ctx);
+        if (ctx->cse) {
+            /* The base may point into env, so order matters. */
+            env_st_read_all(ctx);
+        }
         return false;
     }
 
@@ -2650,6 +2904,9 @@ static bool fold_tcg_st(OptContext *ctx, TCGOp *op)
         g_assert_not_reached();
     }
     remove_mem_copy_in(ctx, ofs, ofs + lm1);
+    if (ctx->cse) {
+        env_st_write(ctx, op, ofs, ofs + lm1);
+    }
     return false;
 }
 
@@ -2683,6 +2940,9 @@ static bool fold_tcg_st_memcopy(OptContext *ctx, TCGOp *op)
     last = ofs + tcg_type_size(type) - 1;
     remove_mem_copy_in(ctx, ofs, last);
     record_mem_copy(ctx, type, src, ofs, last);
+    if (ctx->cse) {
+        env_st_write(ctx, op, ofs, last);
+    }
     return false;
 }
 
@@ -2702,14 +2962,24 @@ static bool fold_xor(OptContext *ctx, TCGOp *op)
     return fold_masks(ctx, op);
 }
 
+static bool tcg_optimize_cse;
+
+void tcg_set_optimize_cse(bool enable)
+{
+    tcg_optimize_cse = enable;
+}
+
 /* Propagate constants and copies, fold constant expressions. */
 void tcg_optimize(TCGContext *s)
 {
     int nb_temps, i;
     TCGOp *op, *op_next;
-    OptContext ctx = { .tcg = s };
+    OptContext ctx = { .tcg = s, .cse = tcg_optimize_cse };
 
     QSIMPLEQ_INIT(&ctx.mem_free);
+    QSIMPLEQ_INIT(&ctx.st_free);
+    QSIMPLEQ_INIT(&ctx.cse_used);
+    QSIMPLEQ_INIT(&ctx.cse_free);
 
     /* Array VALS has an element for each temp.
        If this temp holds a constant then its value is kept in VALS' element.
@@ -2736,6 +3006,16 @@ void tcg_optimize(TCGContext *s)
         init_arguments(&ctx, op, def->nb_oargs + def->nb_iargs);
         copy_propagate(&ctx, op, def->nb_oargs, def->nb_iargs);
 
+        if (ctx.cse) {
+            if (def->flags & (TCG_OPF_BB_END | TCG_OPF_SIDE_EFFECTS |
+                              TCG_OPF_CALL_CLOBBER) ||
+                opc == INDEX_op_plugin_cb || opc == INDEX_op_plugin_mem_cb) {
+                env_st_read_all(&ctx);
+            } else {
+                env_st_read_globals(&ctx, op, def->nb_oargs + def->nb_iargs);
+            }
+        }
+
         /* Pre-compute the type of the operation. */
         if (def->flags & TCG_OPF_VECTOR) {
             ctx.type = TCG_TYPE_V64 + TCGOP_VECL(op);
@@ -2942,6 +3222,27 @@ void tcg_optimize(TCGContext *s)
             break;
         }
 
+        if (!done && ctx.cse) {
+            uint32_t in_version[CSE_MAX_IARGS] = { };
+            CSEInfo *ci;
+
+            /* Folding may have changed the op. */
+            def = &tcg_op_defs[op->opc];
+            if (cse_op_ok(op, def)) {
+                ci = cse_find(&ctx, op, def);
+                if (ci) {
+                    tcg_opt_gen_mov(&ctx, op, op->args[0], temp_arg(ci->ts));
+                    continue;
+                }
+                for (i = 0; i < def->nb_iargs; i++) {
+                    in_version[i] = arg_info(op->args[def->nb_oargs + i])
+                                    ->version;
+                }
+                finish_folding(&ctx, op);
+                cse_record(&ctx, op, def, in_version);
+                continue;
+            }
+        }
         if (!done) {
             finish_folding(&ctx, op);
         }
@@ -29,6 +29,7 @@
 #include "qemu/memalign.h"
 #include "qemu/cacheinfo.h"
 #include "qemu/qtree.h"
+#include "qemu/bitmap.h"
 #include "qapi/error.h"
 #include "tcg/tcg.h"
 #include "exec/translation-block.h"
@@ -69,9 +70,15 @@ struct tcg_region_state {
     size_t stride; /* .size + guard size */
     size_t total_size; /* size of entire buffer, >= n * stride */
 
+    bool evict; /* see tcg_region_set_evict() */
+
     /* fields protected by the lock */
     size_t current; /* current region index */
     size_t agg_size_full; /* aggregate size of full regions */
+    uint64_t *stamp; /* when each region was handed out, for eviction */
+    uint64_t next_stamp;
+    unsigned long *evicted; /* regions to hand out again */
+    unsigned long *counted; /* regions included in agg_size_full */
 };
 
 static struct tcg_region_state region;
@@ -191,10 +198,16 @@ static void tcg_region_trees_init(void)
     }
 }
 
-static struct tcg_region_tree *tc_ptr_to_region_tree(const void *p)
+static size_t tcg_region_index(const void *p)
 {
-    size_t region_idx;
+    if (p < region.start_aligned) {
+        return 0;
+    }
+    return MIN((p - region.start_aligned) / region.stride, region.n - 1);
+}
 
+static struct tcg_region_tree *tc_ptr_to_region_tree(const void *p)
+{
     /*
      * Like tcg_splitwx_to_rw, with no assert.  The pc may come from
      * a signal handler over which the caller has no control.
@@ -206,18 +219,7 @@ static struct tcg_region_tree *tc_ptr_to_region_tree(const void *p)
         }
     }
 
-    if (p < region.start_aligned) {
-        region_idx = 0;
-    } else {
-        ptrdiff_t offset = p - region.start_aligned;
-
-        if (offset > region.stride * (region.n - 1)) {
-            region_idx = region.n - 1;
-        } else {
-            region_idx = offset / region.stride;
-        }
-    }
-    return region_trees + region_idx * tree_size;
+    return region_trees + tcg_region_index(p) * tree_size;
 }
 
 void tcg_tb_insert(TranslationBlock *tb)
@@ -350,6 +352,7 @@ static void tcg_region_assign(TCGContext *s, size_t curr_region)
     void *start, *end;
 
     tcg_region_bounds(curr_region, &start, &end);
+    region.stamp[curr_region] = ++region.next_stamp;
 
     s->code_gen_buffer = start;
     s->code_gen_ptr = start;
@@ -360,7 +363,14 @@ static void tcg_region_assign(TCGContext *s, size_t curr_region)
 static bool tcg_region_alloc__locked(TCGContext *s)
 {
     if (region.current == region.n) {
-        return true;
+        size_t i = find_first_bit(region.evicted, region.n);
+
+        if (i == region.n) {
+            return true;
+        }
+        clear_bit(i, region.evicted);
+        tcg_region_assign(s, i);
+        return false;
     }
     tcg_region_assign(s, region.current);
     region.current++;
@@ -376,11 +386,13 @@ bool tcg_region_alloc(TCGContext *s)
     bool err;
     /* read the region size now; alloc__locked will overwrite it on success */
     size_t size_full = s->code_gen_buffer_size;
+    size_t full = tcg_region_index(s->code_gen_buffer);
 
     qemu_mutex_lock(&region.lock);
     err = tcg_region_alloc__locked(s);
     if (!err) {
         region.agg_size_full += size_full - TCG_HIGHWATER;
+        set_bit(full, region.counted);
     }
     qemu_mutex_unlock(&region.lock);
     return err;
@@ -412,6 +424,8 @@ void tcg_region_reset_all(void)
     qemu_mutex_lock(&region.lock);
     region.current = 0;
     region.agg_size_full = 0;
+    bitmap_zero(region.evicted, region.n);
+    bitmap_zero(region.counted, region.n);
 
     for (i = 0; i < n_ctxs; i++) {
         TCGContext *s = qatomic_read(&tcg_ctxs[i]);
@@ -422,34 +436,133 @@ void tcg_region_reset_all(void)
     tcg_region_tree_reset_all();
 }
 
+/*
+ * Reclaim the buffer a few regions at a time when it fills up, see
+ * tcg_region_evict().  Call before tcg_init(), which sizes the regions.
+ */
+void tcg_region_set_evict(bool evict)
+{
+    region.evict = evict;
+}
+
+/*
+ * Evict the regions that were handed out first, about an eighth of the
+ * buffer, leaving alone those that a TCG context is still filling.
+ * @invalidate is called on each TB in them; it must unlink the TB from
+ * everything that may still reach it, after which the regions are
+ * handed out again by tcg_region_alloc().
+ * Returns false if eviction is disabled or no region can be evicted;
+ * the caller must then flush the whole cache.
+ *
+ * Call from a safe-work context.
+ */
+bool tcg_region_evict(GTraverseFunc invalidate, gpointer user_data)
+{
+    unsigned int n_ctxs = qatomic_read(&tcg_cur_ctxs);
+    g_autofree unsigned long *victims = bitmap_new(region.n);
+    size_t n_victims = MAX(region.n / 8, 1);
+    size_t i;
+
+    if (!region.evict) {
+        return false;
+    }
+
+    qemu_mutex_lock(&region.lock);
+    bitmap_copy(victims, region.evicted, region.n);
+    for (i = 0; i < n_ctxs; i++) {
+        const TCGContext *s = qatomic_read(&tcg_ctxs[i]);
+
+        set_bit(tcg_region_index(s->code_gen_buffer), victims);
+    }
+    /* Of the other regions handed out, keep the n_victims oldest */
+    bitmap_complement(victims, victims, region.n);
+    bitmap_clear(victims, region.current, region.n - region.current);
+    while (bitmap_count_one(victims, region.n) > n_victims) {
+        size_t newest = find_first_bit(victims, region.n);
+
+        for (i = newest + 1; i < region.n; i++) {
+            if (test_bit(i, victims) &&
+                region.stamp[i] > region.stamp[newest]) {
+                newest = i;
+            }
+        }
+        clear_bit(newest, victims);
+    }
+    qemu_mutex_unlock(&region.lock);
+
+    if (bitmap_empty(victims, region.n)) {
+        return false;
+    }
+
+    for (i = find_first_bit(victims, region.n); i < region.n;
+         i = find_next_bit(victims, region.n, i + 1)) {
+        struct tcg_region_tree *rt = region_trees + i * tree_size;
+        void *start, *end;
+
+        qemu_mutex_lock(&rt->lock);
+        q_tree_foreach(rt->tree, invalidate, user_data);
+        /* Increment the refcount first so that destroy acts as a reset */
+        q_tree_ref(rt->tree);
+        q_tree_destroy(rt->tree);
+        qemu_mutex_unlock(&rt->lock);
+
+        qemu_mutex_lock(&region.lock);
+        /*
+         * Regions that no context has moved on from, such as the one the
+         * initial context keeps with MTTCG, were never added.
+         */
+        if (test_and_clear_bit(i, region.counted)) {
+            tcg_region_bounds(i, &start, &end);
+            region.agg_size_full -= end - start - TCG_HIGHWATER;
+        }
+        set_bit(i, region.evicted);
+        qemu_mutex_unlock(&region.lock);
+    }
+    return true;
+}
+
 static size_t tcg_n_regions(size_t tb_size, unsigned max_cpus)
 {
-#ifdef CONFIG_USER_ONLY
-    return 1;
-#else
     size_t n_regions;
 
+#ifdef CONFIG_USER_ONLY
+    n_regions = 1;
+#else
     /*
      * It is likely that some vCPUs will translate more code than others,
      * so we first try to set more regions than max_cpus, with those regions
      * being of reasonable size. If that's not possible we make do by evenly
      * dividing the code_gen_buffer among the vCPUs.
      */
-    /* Use a single region if all we have is one vCPU thread */
     if (max_cpus == 1 || !qemu_tcg_mttcg_enabled()) {
-        return 1;
+        /* Use a single region if all we have is one vCPU thread */
+        n_regions = 1;
+    } else {
+        /*
+         * Try to have more regions than max_cpus, with each region being
+         * >= 2 MB.  If we can't, then just allocate one region per vCPU
+         * thread.
+         */
+        n_regions = tb_size / (2 * MiB);
+        if (n_regions <= max_cpus) {
+            n_regions = max_cpus;
+        } else {
+            n_regions = MIN(n_regions, max_cpus * 8);
+        }
     }
+#endif
 
     /*
-     * Try to have more regions than max_cpus, with each region being >= 2 MB.
-     * If we can't, then just allocate one region per vCPU thread.
+     * Eviction only reclaims regions that no TCG thread is filling, so
+     * make sure there are a few more of them than threads, down to
+     * regions of 256 KiB.
      */
-    n_regions = tb_size / (2 * MiB);
-    if (n_regions <= max_cpus) {
-        return max_cpus;
+    if (region.evict) {
+        size_t n_evict = MIN(MAX(max_cpus * 2, 8), tb_size / (256 * KiB));
+
+        n_regions = MAX(n_regions, n_evict);
     }
-    return MIN(n_regions, max_cpus * 8);
-#endif
+    return n_regions;
 }
 
 /*
@@ -851,6 +964,9 @@ void tcg_region_init(size_t tb_size, int splitwx, unsigned max_cpus)
     }
 
     tcg_region_trees_init();
+    region.stamp = g_new0(uint64_t, region.n);
+    region.evicted = bitmap_new(region.n);
+    region.counted = bitmap_new(region.n);
 
     /*
      * Leave the initial context initialized to the first region.
@@ -1484,9 +1484,12 @@ void tcg_prologue_init(void)
     tcg_region_prologue_set(s);
 }
 
+static void tcg_unpin_hot_globals(TCGContext *s);
+
 void tcg_func_start(TCGContext *s)
 {
     tcg_pool_reset(s);
+    tcg_unpin_hot_globals(s);
     s->nb_temps = s->nb_globals;
 
     /* No temps have been previously allocated for size or locality.  */
@@ -1645,6 +1648,66 @@ TCGv_ptr tcg_global_mem_new_ptr(TCGv_ptr reg, intptr_t off, const char *name)
     return temp_tcgv_ptr(ts);
 }
 
+static unsigned tcg_pinned_limit;
+
+void tcg_set_pinned_limit(unsigned max)
+{
+    tcg_pinned_limit = max;
+}
+
+static bool tcg_hot_pinning;
+
+void tcg_set_hot_pinning(bool enable)
+{
+    tcg_hot_pinning = enable;
+}
+
+#ifdef TCG_TARGET_HAS_PINNED_REGS
+/* The TB entry code reloads pinned globals relative to env only. */
+static bool tcg_global_can_pin(TCGTemp *ts)
+{
+    tcg_debug_assert(ts->kind == TEMP_GLOBAL);
+    return !ts->pinned && ts->base_type == ts->type &&
+           ts->type <= TCG_TYPE_REG && !ts->indirect_reg &&
+           ts->mem_base->kind == TEMP_FIXED &&
+           ts->mem_base->reg == TCG_AREG0;
+}
+#endif
+
+static bool tcg_global_pin_internal(TCGTemp *ts)
+{
+#ifdef TCG_TARGET_HAS_PINNED_REGS
+    TCGContext *s = tcg_ctx;
+    TCGReg reg;
+
+    if (s->nb_pinned >= MIN(tcg_pinned_limit,
+                            ARRAY_SIZE(tcg_target_pinned_regs))) {
+        return false;
+    }
+    if (!tcg_global_can_pin(ts)) {
+        return false;
+    }
+
+    reg = tcg_target_pinned_regs[s->nb_pinned++];
+    tcg_regset_set_reg(s->reserved_regs, reg);
+    ts->pinned = 1;
+    ts->pin_reg = reg;
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool tcg_global_pin_i32(TCGv_i32 v)
+{
+    return tcg_global_pin_internal(tcgv_i32_temp(v));
+}
+
+bool tcg_global_pin_i64(TCGv_i64 v)
+{
+    return tcg_global_pin_internal(tcgv_i64_temp(v));
+}
+
 TCGTemp *tcg_temp_new_internal(TCGType type, TCGTempKind kind)
 {
     TCGContext *s = tcg_ctx;
@@ -2416,6 +2479,22 @@ static void tcg_reg_alloc_start(TCGContext *s)
     }
 
     memset(s->reg_to_temp, 0, sizeof(s->reg_to_temp));
+
+    /*
+     * The code before tb->chain_offset, or the previous TB, loaded them;
+     * the code after it loads those pinned for this TB only.
+     */
+    for (i = 0, n = s->nb_globals;
+         i < n && (s->nb_pinned || s->nb_hot_pinned); i++) {
+        TCGTemp *ts = &s->temps[i];
+
+        if (ts->pinned) {
+            ts->val_type = TEMP_VAL_REG;
+            ts->reg = ts->pin_reg;
+            ts->mem_coherent = 1;
+            s->reg_to_temp[ts->reg] = ts;
+        }
+    }
 }
 
 static char *tcg_get_arg_str_ptr(TCGContext *s, char *buf, int buf_size,
@@ -4221,6 +4300,43 @@ static void set_temp_val_nonreg(TCGContext *s, TCGTemp *ts, TCGTempVal type)
     ts->val_type = type;
 }
 
+/*
+ * Put a pinned global back into its host register, once its value is
+ * coherent with memory.  A value only present in memory is reloaded
+ * if @load, and otherwise left there until the end of the block.
+ */
+static void temp_pin_home(TCGContext *s, TCGTemp *ts, bool load)
+{
+    TCGReg reg = ts->pin_reg;
+    bool ok;
+
+    tcg_debug_assert(ts->pinned);
+    tcg_debug_assert(ts->mem_coherent || ts->val_type == TEMP_VAL_MEM);
+
+    switch (ts->val_type) {
+    case TEMP_VAL_REG:
+        if (ts->reg == reg) {
+            return;
+        }
+        ok = tcg_out_mov(s, ts->type, reg, ts->reg);
+        tcg_debug_assert(ok);
+        break;
+    case TEMP_VAL_CONST:
+        tcg_out_movi(s, ts->type, reg, ts->val);
+        break;
+    case TEMP_VAL_MEM:
+        if (!load) {
+            return;
+        }
+        tcg_out_ld(s, ts->type, reg, ts->mem_base->reg, ts->mem_offset);
+        break;
+    default:
+        g_assert_not_reached();
+    }
+    set_temp_val_reg(s, ts, reg);
+    ts->mem_coherent = 1;
+}
+
 static void temp_load(TCGContext *, TCGTemp *, TCGRegSet, TCGRegSet, TCGRegSet);
 
 /* Mark a temporary as free or dead.  If 'free_or_dead' is negative,
@@ -4233,6 +4349,13 @@ static void temp_free_or_dead(TCGContext *s, TCGTemp *ts, int free_or_dead)
     case TEMP_FIXED:
         return;
     case TEMP_GLOBAL:
+        if (ts->pinned &&
+            (ts->mem_coherent || ts->val_type == TEMP_VAL_MEM)) {
+            temp_pin_home(s, ts, false);
+            return;
+        }
+        /* A discarded pinned global is reloaded at the end of the block. */
+        /* fall through */
     case TEMP_TB:
         new_type = TEMP_VAL_MEM;
         break;
@@ -4462,8 +4585,13 @@ static void temp_load(TCGContext *s, TCGTemp *ts, TCGRegSet desired_regs,
         ts->mem_coherent = 0;
         break;
     case TEMP_VAL_MEM:
-        reg = tcg_reg_alloc(s, desired_regs, allocated_regs,
-                            preferred_regs, ts->indirect_base);
+        if (ts->pinned && tcg_regset_test_reg(desired_regs, ts->pin_reg)) {
+            /* Only @ts may use its reserved register. */
+            reg = ts->pin_reg;
+        } else {
+            reg = tcg_reg_alloc(s, desired_regs, allocated_regs,
+                                preferred_regs, ts->indirect_base);
+        }
         tcg_out_ld(s, ts->type, reg, ts->mem_base->reg, ts->mem_offset);
         ts->mem_coherent = 1;
         break;
@@ -4478,6 +4606,18 @@ static void temp_load(TCGContext *s, TCGTemp *ts, TCGRegSet desired_regs,
    temporary registers needs to be allocated to store a constant.  */
 static void temp_save(TCGContext *s, TCGTemp *ts, TCGRegSet allocated_regs)
 {
+    if (ts->pinned) {
+        /*
+         * Dead pinned globals stay in their register, in sync with
+         * memory, which the following code may change.
+         */
+        tcg_debug_assert(ts->val_type == TEMP_VAL_MEM || ts->mem_coherent);
+        if (ts->val_type == TEMP_VAL_REG) {
+            set_temp_val_nonreg(s, ts, TEMP_VAL_MEM);
+        }
+        return;
+    }
+
     /* The liveness analysis already ensures that globals are back
        in memory. Keep an tcg_debug_assert for safety. */
     tcg_debug_assert(ts->val_type == TEMP_VAL_MEM || temp_readonly(ts));
@@ -4510,6 +4650,129 @@ static void sync_globals(TCGContext *s, TCGRegSet allocated_regs)
     }
 }
 
+/* put pinned globals back in their host register, where the code at
+   labels and the TBs chained to this one expect them.  At a TB exit,
+   the globals pinned for this TB only can stay in memory. */
+static void pin_globals(TCGContext *s, bool tb_exit)
+{
+    int i, n;
+
+    for (i = 0, n = s->nb_globals;
+         i < n && (s->nb_pinned || s->nb_hot_pinned); i++) {
+        TCGTemp *ts = &s->temps[i];
+        if (ts->pinned &&
+            !(tb_exit && tcg_regset_test_reg(s->hot_pin_regs, ts->pin_reg))) {
+            temp_pin_home(s, ts, true);
+        }
+    }
+}
+
+/*
+ * Minimum number of parts of a hot TB, as split by labels, branches and
+ * helper calls, in which a global must be used to be pinned to a host
+ * register for the TB: each part after the first would otherwise load it
+ * again, against a single load at the start of the TB.
+ */
+#define TCG_HOT_PIN_MIN_PARTS 3
+
+/*
+ * In a TB that was found hot (tcg_ctx->hot), pin the globals that are
+ * used throughout it to the pinnable host registers left over by
+ * tcg_global_pin_*().  They then stay in their register across the
+ * labels, branches and helper calls inside the TB, as globals pinned
+ * across TBs do, but are loaded on every entry to the TB, and need not
+ * be in their register when it exits.
+ */
+static void tcg_pin_hot_globals(TCGContext *s)
+{
+#ifdef TCG_TARGET_HAS_PINNED_REGS
+    int nb_globals = s->nb_globals;
+    int *parts, *last_part, part = 0;
+    TCGOp *op;
+    int i, j;
+
+    if (!s->hot || !tcg_hot_pinning) {
+        return;
+    }
+
+    parts = tcg_malloc(sizeof(int) * nb_globals * 2);
+    last_part = parts + nb_globals;
+    for (i = 0; i < nb_globals; i++) {
+        parts[i] = 0;
+        last_part[i] = -1;
+    }
+
+    QTAILQ_FOREACH(op, &s->ops, link) {
+        const TCGOpDef *def = &tcg_op_defs[op->opc];
+        int nb_args;
+
+        if (op->opc == INDEX_op_set_label) {
+            part++;
+            continue;
+        }
+        if (op->opc == INDEX_op_call) {
+            nb_args = TCGOP_CALLO(op) + TCGOP_CALLI(op);
+        } else {
+            nb_args = def->nb_oargs + def->nb_iargs;
+        }
+        for (i = 0; i < nb_args; i++) {
+            j = temp_idx(arg_temp(op->args[i]));
+            if (j < nb_globals && last_part[j] != part) {
+                last_part[j] = part;
+                parts[j]++;
+            }
+        }
+        if (op->opc == INDEX_op_call || (def->flags & TCG_OPF_BB_END)) {
+            part++;
+        }
+    }
+
+    for (i = s->nb_pinned; i < ARRAY_SIZE(tcg_target_pinned_regs); i++) {
+        TCGReg reg = tcg_target_pinned_regs[i];
+        int best = -1;
+
+        if (tcg_regset_test_reg(s->reserved_regs, reg)) {
+            continue;
+        }
+        for (j = 0; j < nb_globals; j++) {
+            TCGTemp *ts = &s->temps[j];
+
+            if (ts->kind == TEMP_GLOBAL &&
+                parts[j] >= TCG_HOT_PIN_MIN_PARTS &&
+                (best < 0 || parts[j] > parts[best]) &&
+                tcg_global_can_pin(ts)) {
+                best = j;
+            }
+        }
+        if (best < 0) {
+            break;
+        }
+
+        tcg_regset_set_reg(s->reserved_regs, reg);
+        tcg_regset_set_reg(s->hot_pin_regs, reg);
+        s->temps[best].pinned = 1;
+        s->temps[best].pin_reg = reg;
+        s->nb_hot_pinned++;
+    }
+#endif
+}
+
+static void tcg_unpin_hot_globals(TCGContext *s)
+{
+    int i;
+
+    for (i = 0; i < s->nb_globals && s->nb_hot_pinned; i++) {
+        TCGTemp *ts = &s->temps[i];
+
+        if (ts->pinned && tcg_regset_test_reg(s->hot_pin_regs, ts->pin_reg)) {
+            ts->pinned = 0;
+            s->nb_hot_pinned--;
+        }
+    }
+    s->reserved_regs &= ~s->hot_pin_regs;
+    s->hot_pin_regs = 0;
+}
+
 /* at the end of a basic block, we assume all temporaries are dead and
    all globals are stored at their canonical location. */
 static void tcg_reg_alloc_bb_end(TCGContext *s, TCGRegSet allocated_regs)
@@ -4537,7 +4800,14 @@ static void tcg_reg_alloc_bb_end(TCGContext *s, TCGRegSet allocated_regs)
         }
     }
 
-    save_globals(s, allocated_regs);
+    for (i = 0; i < s->nb_globals; i++) {
+        TCGTemp *ts = &s->temps[i];
+
+        if (!ts->pinned) {
+            temp_save(s, ts, allocated_regs);
+        }
+    }
+    pin_globals(s, false);
 }
 
 /*
@@ -4548,6 +4818,7 @@ static void tcg_reg_alloc_bb_end(TCGContext *s, TCGRegSet allocated_regs)
 static void tcg_reg_alloc_cbranch(TCGContext *s, TCGRegSet allocated_regs)
 {
     sync_globals(s, allocated_regs);
+    pin_globals(s, false);
 
     for (int i = s->nb_globals; i < s->nb_temps; i++) {
         TCGTemp *ts = &s->temps[i];
@@ -4633,7 +4904,7 @@ static void tcg_reg_alloc_mov(TCGContext *s, const TCGOp *op)
     tcg_debug_assert(ts->val_type == TEMP_VAL_REG);
     ireg = ts->reg;
 
-    if (IS_DEAD_ARG(0)) {
+    if (IS_DEAD_ARG(0) && !ots->pinned) {
         /* mov to a non-saved dead register makes no sense (even with
            liveness analysis disabled). */
         tcg_debug_assert(NEED_SYNC_ARG(0));
@@ -4648,7 +4919,7 @@ static void tcg_reg_alloc_mov(TCGContext *s, const TCGOp *op)
         return;
     }
 
-    if (IS_DEAD_ARG(1) && ts->kind != TEMP_FIXED) {
+    if (IS_DEAD_ARG(1) && ts->kind != TEMP_FIXED && !ts->pinned) {
         /*
          * The mov can be suppressed.  Kill input first, so that it
          * is unlinked from reg_to_temp, then set the output to the
@@ -4684,8 +4955,12 @@ static void tcg_reg_alloc_mov(TCGContext *s, const TCGOp *op)
     set_temp_val_reg(s, ots, oreg);
     ots->mem_coherent = 0;
 
+    /* A dead input only gets here if it is fixed or pinned. */
+    if (IS_DEAD_ARG(1)) {
+        temp_dead(s, ts);
+    }
     if (NEED_SYNC_ARG(0)) {
-        temp_sync(s, ots, allocated_regs, 0, 0);
+        temp_sync(s, ots, allocated_regs, 0, IS_DEAD_ARG(0));
     }
 }
 
@@ -4891,7 +5166,7 @@ static void tcg_reg_alloc_op(TCGContext *s, const TCGOp *op)
                  * dead after the instruction, we must allocate a new
                  * register and move it.
                  */
-                if (temp_readonly(ts) || !IS_DEAD_ARG(i)
+                if (temp_readonly(ts) || ts->pinned || !IS_DEAD_ARG(i)
                     || def->args_ct[arg_ct->alias_index].newreg) {
                     allocate_new_reg = true;
                 } else if (ts->val_type == TEMP_VAL_REG) {
@@ -4936,7 +5211,7 @@ static void tcg_reg_alloc_op(TCGContext *s, const TCGOp *op)
                 i_preferred_regs = output_pref(op, arg_ct->alias_index);
                 if (IS_DEAD_ARG(i1) &&
                     IS_DEAD_ARG(i2) &&
-                    !temp_readonly(ts) &&
+                    !temp_readonly(ts) && !ts->pinned &&
                     ts->val_type == TEMP_VAL_REG &&
                     ts->reg < TCG_TARGET_NB_REGS - 1 &&
                     tcg_regset_test_reg(i_required_regs, reg) &&
@@ -4972,7 +5247,7 @@ static void tcg_reg_alloc_op(TCGContext *s, const TCGOp *op)
             i_preferred_regs = output_pref(op, arg_ct->alias_index);
 
             if (IS_DEAD_ARG(i) &&
-                !temp_readonly(ts) &&
+                !temp_readonly(ts) && !ts->pinned &&
                 ts->val_type == TEMP_VAL_REG &&
                 reg > 0 &&
                 s->reg_to_temp[reg - 1] == NULL &&
@@ -4994,7 +5269,8 @@ static void tcg_reg_alloc_op(TCGContext *s, const TCGOp *op)
              * If an aliased input is not dead after the instruction,
              * we must allocate a new register and move it.
              */
-            if (arg_ct->ialias && (!IS_DEAD_ARG(i) || temp_readonly(ts))) {
+            if (arg_ct->ialias &&
+                (!IS_DEAD_ARG(i) || temp_readonly(ts) || ts->pinned)) {
                 TCGRegSet t_allocated_regs = i_allocated_regs;
 
                 /*
@@ -5090,6 +5366,10 @@ static void tcg_reg_alloc_op(TCGContext *s, const TCGOp *op)
             case 0: /* not paired */
                 if (arg_ct->oalias && !const_args[arg_ct->alias_index]) {
                     reg = new_args[arg_ct->alias_index];
+                } else if (ts->pinned && !arg_ct->newreg &&
+                           tcg_regset_test_reg(arg_ct->regs, ts->pin_reg)) {
+                    /* Write straight into the register it lives in. */
+                    reg = ts->pin_reg;
                 } else if (arg_ct->newreg) {
                     reg = tcg_reg_alloc(s, arg_ct->regs,
                                         i_allocated_regs | o_allocated_regs,
@@ -6121,7 +6401,9 @@ int tcg_gen_code(TCGContext *s, TranslationBlock *tb, uint64_t pc_start)
     }
 #endif
 
-    tcg_optimize(s);
+    if (!s->no_optimize) {
+        tcg_optimize(s);
+    }
 
     reachable_code_pass(s);
     liveness_pass_0(s);
@@ -6163,6 +6445,7 @@ int tcg_gen_code(TCGContext *s, TranslationBlock *tb, uint64_t pc_start)
     tb->jmp_insn_offset[0] = TB_JMP_OFFSET_INVALID;
     tb->jmp_insn_offset[1] = TB_JMP_OFFSET_INVALID;
 
+    tcg_pin_hot_globals(s);
     tcg_reg_alloc_start(s);
 
     /*
@@ -6186,6 +6469,33 @@ int tcg_gen_code(TCGContext *s, TranslationBlock *tb, uint64_t pc_start)
 
     tcg_out_tb_start(s);
 
+    /*
+     * Entering from the main loop, pinned globals must be loaded from
+     * env.  Other TBs jump past this, with the registers already set.
+     */
+    tb->chain_offset = 0;
+    if (s->nb_pinned) {
+        for (i = 0; i < s->nb_globals; i++) {
+            TCGTemp *ts = &s->temps[i];
+
+            if (ts->pinned &&
+                !tcg_regset_test_reg(s->hot_pin_regs, ts->pin_reg)) {
+                tcg_out_ld(s, ts->type, ts->pin_reg,
+                           ts->mem_base->reg, ts->mem_offset);
+            }
+        }
+        tb->chain_offset = tcg_current_code_size(s);
+        tcg_out_tb_start(s);
+    }
+    for (i = 0; i < s->nb_globals && s->nb_hot_pinned; i++) {
+        TCGTemp *ts = &s->temps[i];
+
+        if (ts->pinned && tcg_regset_test_reg(s->hot_pin_regs, ts->pin_reg)) {
+            tcg_out_ld(s, ts->type, ts->pin_reg,
+                       ts->mem_base->reg, ts->mem_offset);
+        }
+    }
+
     num_insns = -1;
     QTAILQ_FOREACH(op, &s->ops, link) {
         TCGOpcode opc = op->opc;
@@ -6226,6 +6536,7 @@ int tcg_gen_code(TCGContext *s, TranslationBlock *tb, uint64_t pc_start)
             tcg_out_exit_tb(s, op->args[0]);
             break;
         case INDEX_op_goto_tb:
+            pin_globals(s, true);
             tcg_out_goto_tb(s, op->args[0]);
             break;
         case INDEX_op_dup2_vec:
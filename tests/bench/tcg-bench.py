@@ -0,0 +1,107 @@
+#!/usr/bin/env python3
+#
+# Compare TCG accelerator configurations on guest benchmarks
+#
+# Runs each guest program under a user mode emulator with each set of
+# -accel options, and reports the best wall clock time out of a few runs,
+# along with the number of TBs and the bytes of host code generated (from
+# a separate run with -d out_asm, as logging slows down execution).
+#
+# Example, with the RISC-V benchmarks from tests/tcg/riscv64:
+#
+#   tcg-bench.py --qemu ./qemu-riscv64 --cpu rv64,v=true,vlen=256 \
+#       -c base=tcg -c cse=tcg,cse=on \
+#       tests/tcg/riscv64-linux-user/test-rvv-bench \
+#       tests/tcg/riscv64-linux-user/test-fp-bench
+#
+# SPDX-License-Identifier: GPL-2.0-or-later
+
+import argparse
+import os
+import re
+import subprocess
+import sys
+import tempfile
+import time
+
+
+def run(qemu, args, bench, log=None):
+    cmd = [qemu] + args
+    if log:
+        cmd += ['-d', 'out_asm', '-D', log]
+    cmd.append(bench)
+    start = time.perf_counter()
+    proc = subprocess.run(cmd, stdout=subprocess.PIPE,
+                          stderr=subprocess.STDOUT, text=True)
+    elapsed = time.perf_counter() - start
+    if proc.returncode:
+        sys.exit('{} failed ({}):\n{}'.format(' '.join(cmd),
+                                             proc.returncode, proc.stdout))
+    return elapsed, proc.stdout
+
+
+def code_size(qemu, args, bench):
+    with tempfile.TemporaryDirectory() as tmp:
+        log = os.path.join(tmp, 'out_asm.log')
+        run(qemu, args, bench, log)
+        tbs = size = 0
+        with open(log, errors='replace') as f:
+            for line in f:
+                m = re.match(r'OUT: \[size=(\d+)\]', line)
+                if m:
+                    tbs += 1
+                    size += int(m.group(1))
+    return tbs, size
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Compare TCG configurations on guest benchmarks')
+    parser.add_argument('--qemu', required=True,
+                        help='user mode emulator to run')
+    parser.add_argument('--cpu', help='-cpu option for the emulator')
+    parser.add_argument('-c', '--config', action='append', default=[],
+                        metavar='NAME=ACCEL',
+                        help='-accel option to compare, e.g. cse=tcg,cse=on '
+                             '(repeatable; the first one is the reference)')
+    parser.add_argument('-n', '--runs', type=int, default=3,
+                        help='timed runs per benchmark (default 3)')
+    parser.add_argument('-v', '--verbose', action='store_true',
+                        help='print the output of the benchmarks')
+    parser.add_argument('bench', nargs='+', help='guest benchmark programs')
+    args = parser.parse_args()
+
+    configs = []
+    for c in args.config or ['base=tcg']:
+        name, sep, accel = c.partition('=')
+        if not sep:
+            sys.exit('bad configuration {}, expected NAME=ACCEL'.format(c))
+        configs.append((name, accel))
+
+    print('{:24} {:10} {:>9} {:>8} {:>7} {:>10} {:>8}'.format(
+        'benchmark', 'config', 'time (s)', 'speedup', 'TBs',
+        'host code', 'size'))
+    for bench in args.bench:
+        ref = None
+        for name, accel in configs:
+            qemu_args = ['-accel', accel]
+            if args.cpu:
+                qemu_args += ['-cpu', args.cpu]
+
+            best = None
+            for _ in range(args.runs):
+                elapsed, out = run(args.qemu, qemu_args, bench)
+                best = elapsed if best is None else min(best, elapsed)
+            if args.verbose:
+                print(out, end='')
+            tbs, size = code_size(args.qemu, qemu_args, bench)
+
+            if ref is None:
+                ref = (best, size)
+            print('{:24} {:10} {:9.3f} {:7.2f}x {:7} {:10} {:7.1f}%'.format(
+                os.path.basename(bench), name, best, ref[0] / best, tbs,
+                size, 100.0 * size / ref[1] if ref[1] else 0))
+
+
+if __name__ == '__main__':
+    main()
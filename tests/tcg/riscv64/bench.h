@@ -0,0 +1,74 @@
+/*
+ * Common code for the RISC-V micro-benchmarks
+ *
+ * Each benchmark runs a kernel ITERS times, reports the time per guest
+ * instruction and then checks the kernel's result, so that it doubles as
+ * a correctness test.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+typedef struct Bench {
+    const char *name;
+    /* Returns the number of instructions it executed */
+    long (*kernel)(void);
+    /* Returns nonzero on a wrong result; @status is from run_benches() */
+    int (*check)(unsigned long status);
+} Bench;
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void report(const char *name, int64_t ns, long insns)
+{
+    printf("%-12s %8.2f ns/insn\n", name, (double)ns / insns);
+}
+
+/*
+ * Run and check @n benchmarks.  If given, @start is called before each
+ * one, and @status right after its last iteration; the value it returns
+ * is passed to the check.  Returns nonzero if any check failed.
+ */
+static int run_benches(const Bench *benches, int n, long iters,
+                       void (*start)(void), unsigned long (*status)(void))
+{
+    int i, err = 0;
+
+    for (i = 0; i < n; i++) {
+        unsigned long st = 0;
+        long insns = 0;
+        int64_t t0;
+        long j;
+
+        if (start) {
+            start();
+        }
+        t0 = now_ns();
+        for (j = 0; j < iters; j++) {
+            insns += benches[i].kernel();
+        }
+        if (status) {
+            st = status();
+        }
+        report(benches[i].name, now_ns() - t0, insns);
+
+        if (benches[i].check(st)) {
+            printf("%s: result mismatch\n", benches[i].name);
+            err = 1;
+        }
+    }
+    return err;
+}
+
+#endif
@@ -0,0 +1,68 @@
+/*
+ * Misaligned AMOs within a 16-byte block (Zama16b) from several threads
+ *
+ * Each thread adds to counters at misaligned offsets, both inside and
+ * across the aligned doublewords of a 16-byte block, and to an aligned
+ * one through the same instruction as a misaligned one, so that the TB
+ * takes both paths.  With the updates done atomically, the totals come
+ * out exact.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define NTHREADS    4
+#define ITERS       100000
+
+static uint8_t block[16] __attribute__((aligned(16)));
+
+static void *worker(void *arg)
+{
+    uint32_t old;
+    int i;
+
+    for (i = 0; i < ITERS; i++) {
+        /* Bytes 12-15, aligned, then bytes 1-4 again */
+        uint8_t *p = i & 1 ? block + 1 : block + 12;
+
+        asm volatile("amoadd.w %0, %2, (%1)"
+                     : "=r"(old) : "r"(p), "r"(1) : "memory");
+        assert(old < 2 * NTHREADS * ITERS);
+        /* Bytes 1-4: inside the first doubleword */
+        asm volatile("amoadd.w zero, %1, (%0)"
+                     : : "r"(block + 1), "r"(1) : "memory");
+        /* Bytes 6-9: across the two doublewords */
+        asm volatile("amoadd.w zero, %1, (%0)"
+                     : : "r"(block + 6), "r"(1) : "memory");
+    }
+    return NULL;
+}
+
+int main(void)
+{
+    pthread_t threads[NTHREADS];
+    uint32_t a, b, c;
+    int i;
+
+    for (i = 0; i < NTHREADS; i++) {
+        pthread_create(&threads[i], NULL, worker, NULL);
+    }
+    for (i = 0; i < NTHREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    memcpy(&a, block + 1, 4);
+    memcpy(&b, block + 6, 4);
+    memcpy(&c, block + 12, 4);
+    printf("a = %u, b = %u, c = %u\n", a, b, c);
+    assert(a == NTHREADS * ITERS + NTHREADS * (ITERS / 2));
+    assert(b == NTHREADS * ITERS);
+    assert(c == NTHREADS * (ITERS / 2));
+    assert(block[0] == 0 && block[5] == 0 && block[10] == 0);
+    return 0;
+}
@@ -0,0 +1,201 @@
+/*
+ * Scalar floating point benchmark
+ *
+ * A few loop kernels in the spirit of SPEC fp (axpy, dot product, stencil,
+ * normalisation) using single and double precision arithmetic.  The data
+ * are small integers so that every result is exact and can be checked
+ * against integer arithmetic, along with the inexact flag, which must only
+ * be raised by the kernels that round.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "bench.h"
+
+#define N       512
+#define ITERS   2000
+
+#define FFLAGS_NX   1
+
+static double xd[N], yd[N], zd[N];
+static float xs[N], ys[N];
+static float dot_s;
+
+static void clear_fflags(void)
+{
+    asm volatile("csrw fflags, zero");
+}
+
+static unsigned long read_fflags(void)
+{
+    unsigned long flags;
+
+    asm volatile("csrr %0, fflags" : "=r"(flags));
+    return flags;
+}
+
+static void init(void)
+{
+    int i;
+
+    for (i = 0; i < N; i++) {
+        xd[i] = i - N / 2;
+        yd[i] = 3 * i + 1;
+        xs[i] = i % 64;
+        ys[i] = 64 - i % 64;
+    }
+}
+
+/* y = a * x + y with fmadd.d */
+static long kernel_daxpy(void)
+{
+    double a = 3.0;
+    int i;
+
+    for (i = 0; i < N; i++) {
+        asm("fmadd.d %0, %1, %2, %3"
+            : "=f"(zd[i]) : "f"(a), "f"(xd[i]), "f"(yd[i]));
+    }
+    return N;
+}
+
+/* Dot product with fmadd.s */
+static long kernel_sdot(void)
+{
+    float acc = 0;
+    int i;
+
+    for (i = 0; i < N; i++) {
+        asm("fmadd.s %0, %1, %2, %0" : "+f"(acc) : "f"(xs[i]), "f"(ys[i]));
+    }
+    dot_s = acc;
+    return N;
+}
+
+/* Three point stencil with fadd.d and fmul.d */
+static long kernel_stencil(void)
+{
+    double quarter = 0.25;
+    int i;
+
+    for (i = 1; i < N - 1; i++) {
+        double t;
+
+        asm("fadd.d %0, %1, %2\n\t"
+            "fadd.d %0, %0, %3\n\t"
+            "fadd.d %0, %0, %3\n\t"
+            "fmul.d %0, %0, %4"
+            : "=&f"(t)
+            : "f"(xd[i - 1]), "f"(xd[i + 1]), "f"(xd[i]), "f"(quarter));
+        zd[i] = t;
+    }
+    return (N - 2) * 4;
+}
+
+/* Normalise by a constant with fdiv.d; rounds for most elements */
+static long kernel_ddiv(void)
+{
+    double three = 3.0;
+    int i;
+
+    for (i = 0; i < N; i++) {
+        asm("fdiv.d %0, %1, %2" : "=f"(zd[i]) : "f"(yd[i]), "f"(three));
+    }
+    return N;
+}
+
+/* Single precision fsub.s and fmul.s */
+static long kernel_smul(void)
+{
+    int i;
+
+    for (i = 0; i < N; i++) {
+        float t;
+
+        asm("fsub.s %0, %1, %2\n\t"
+            "fmul.s %0, %0, %1"
+            : "=&f"(t) : "f"(xs[i]), "f"(ys[i]));
+        zd[i] = t;
+    }
+    return N * 2;
+}
+
+static int check_daxpy(unsigned long fflags)
+{
+    int i;
+
+    for (i = 0; i < N; i++) {
+        if (zd[i] != 3 * (i - N / 2) + 3 * i + 1) {
+            return 1;
+        }
+    }
+    return fflags & FFLAGS_NX;
+}
+
+static int check_sdot(unsigned long fflags)
+{
+    long ref = 0;
+    int i;
+
+    for (i = 0; i < N; i++) {
+        ref += (i % 64) * (64 - i % 64);
+    }
+    return dot_s != ref || (fflags & FFLAGS_NX);
+}
+
+static int check_stencil(unsigned long fflags)
+{
+    int i;
+
+    /* x is linear, so the stencil gives it back */
+    for (i = 1; i < N - 1; i++) {
+        if (zd[i] != i - N / 2) {
+            return 1;
+        }
+    }
+    return fflags & FFLAGS_NX;
+}
+
+static int check_ddiv(unsigned long fflags)
+{
+    int i;
+
+    for (i = 0; i < N; i++) {
+        if (zd[i] != (double)(3 * i + 1) / 3) {
+            return 1;
+        }
+    }
+    /* None of the quotients is exact */
+    return !(fflags & FFLAGS_NX);
+}
+
+static int check_smul(unsigned long fflags)
+{
+    int i;
+
+    for (i = 0; i < N; i++) {
+        long x = i % 64, y = 64 - i % 64;
+
+        if (zd[i] != (x - y) * x) {
+            return 1;
+        }
+    }
+    return fflags & FFLAGS_NX;
+}
+
+static const Bench benches[] = {
+    { "daxpy",   kernel_daxpy,   check_daxpy },
+    { "sdot",    kernel_sdot,    check_sdot },
+    { "stencil", kernel_stencil, check_stencil },
+    { "ddiv",    kernel_ddiv,    check_ddiv },
+    { "smul",    kernel_smul,    check_smul },
+};
+
+int main(void)
+{
+    init();
+
+    /* The checks get fflags as read before anything else gets to round */
+    return run_benches(benches, sizeof(benches) / sizeof(benches[0]), ITERS,
+                       clear_fflags, read_fflags);
+}
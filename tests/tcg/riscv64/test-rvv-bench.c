@@ -0,0 +1,165 @@
+/*
+ * Micro-benchmarks for common RVV instructions
+ *
+ * Each kernel runs a short vector loop many times, reports the time per
+ * instruction and checks the final result against a scalar reference so
+ * that the benchmark doubles as a correctness test.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <string.h>
+
+#include "bench.h"
+
+#define N       256
+#define ITERS   20000
+
+static int32_t a[N], b[N], c[N], ref[N];
+static uint8_t mask_a[N / 8], mask_b[N / 8], mask_c[N / 8];
+
+/* vle32 + vadd.vv + vse32 over the whole array */
+static long kernel_vadd(void)
+{
+    long insns = 0;
+    size_t i, vl;
+
+    for (i = 0; i < N; i += vl) {
+        asm volatile("vsetvli %0, %1, e32, m1, ta, ma\n\t"
+                     "vle32.v v1, (%2)\n\t"
+                     "vle32.v v2, (%3)\n\t"
+                     "vadd.vv v3, v1, v2\n\t"
+                     "vse32.v v3, (%4)\n\t"
+                     : "=&r"(vl)
+                     : "r"(N - i), "r"(a + i), "r"(b + i), "r"(c + i)
+                     : "memory", "v1", "v2", "v3");
+        insns += 5;
+    }
+    return insns;
+}
+
+/* vmin.vx against a scalar */
+static long kernel_vmin_vx(void)
+{
+    long insns = 0;
+    size_t i, vl;
+    long x = 7;
+
+    for (i = 0; i < N; i += vl) {
+        asm volatile("vsetvli %0, %1, e32, m1, ta, ma\n\t"
+                     "vle32.v v1, (%2)\n\t"
+                     "vmin.vx v3, v1, %4\n\t"
+                     "vse32.v v3, (%3)\n\t"
+                     : "=&r"(vl)
+                     : "r"(N - i), "r"(a + i), "r"(c + i), "r"(x)
+                     : "memory", "v1", "v3");
+        insns += 4;
+    }
+    return insns;
+}
+
+/* vmseq.vv producing a mask, stored with vsm */
+static long kernel_vmseq(void)
+{
+    long insns = 0;
+    size_t i, vl;
+
+    for (i = 0; i < N; i += vl) {
+        asm volatile("vsetvli %0, %1, e32, m1, ta, ma\n\t"
+                     "vle32.v v1, (%2)\n\t"
+                     "vle32.v v2, (%3)\n\t"
+                     "vmseq.vv v3, v1, v2\n\t"
+                     "vsetvli zero, %0, e8, m1, ta, ma\n\t"
+                     "vsm.v v3, (%4)\n\t"
+                     : "=&r"(vl)
+                     : "r"(N - i), "r"(a + i), "r"(b + i),
+                       "r"(mask_c + i / 8)
+                     : "memory", "v1", "v2", "v3");
+        insns += 6;
+    }
+    return insns;
+}
+
+/* vmand.mm on whole mask registers */
+static long kernel_vmand(void)
+{
+    size_t vl;
+
+    asm volatile("vsetvli %0, %1, e8, m8, ta, ma\n\t"
+                 "vlm.v v1, (%2)\n\t"
+                 "vlm.v v2, (%3)\n\t"
+                 "vmand.mm v3, v1, v2\n\t"
+                 "vsm.v v3, (%4)\n\t"
+                 : "=&r"(vl)
+                 : "r"((size_t)N), "r"(mask_a), "r"(mask_b), "r"(mask_c)
+                 : "memory", "v1", "v2", "v3");
+    return 5;
+}
+
+static int check_vadd(unsigned long status)
+{
+    int i;
+
+    for (i = 0; i < N; i++) {
+        ref[i] = a[i] + b[i];
+    }
+    return memcmp(c, ref, sizeof(c));
+}
+
+static int check_vmin_vx(unsigned long status)
+{
+    int i;
+
+    for (i = 0; i < N; i++) {
+        ref[i] = a[i] < 7 ? a[i] : 7;
+    }
+    return memcmp(c, ref, sizeof(c));
+}
+
+static int check_vmseq(unsigned long status)
+{
+    int i;
+
+    for (i = 0; i < N; i++) {
+        if (!!(mask_c[i / 8] & (1 << (i % 8))) != (a[i] == b[i])) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int check_vmand(unsigned long status)
+{
+    int i;
+
+    for (i = 0; i < N / 8; i++) {
+        if (mask_c[i] != (mask_a[i] & mask_b[i])) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static const Bench benches[] = {
+    { "vadd.vv",  kernel_vadd,    check_vadd },
+    { "vmin.vx",  kernel_vmin_vx, check_vmin_vx },
+    { "vmseq.vv", kernel_vmseq,   check_vmseq },
+    { "vmand.mm", kernel_vmand,   check_vmand },
+};
+
+int main(void)
+{
+    int i;
+
+    for (i = 0; i < N; i++) {
+        a[i] = i * 37 - 1000;
+        b[i] = (i % 3) ? a[i] : i;
+    }
+    for (i = 0; i < N / 8; i++) {
+        mask_a[i] = i * 29;
+        mask_b[i] = ~(i * 13);
+    }
+
+    return run_benches(benches, sizeof(benches) / sizeof(benches[0]), ITERS,
+                       NULL, NULL);
+}